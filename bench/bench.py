@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+# Times lst on the trees made by gen_tree.py and writes a JSON report:
+#
+#   python3 bench/bench.py [--repeat=10] [--cold=3] [--only=REGEX] LST TREES
+#
+# Every case is run once to warm the caches and then --repeat times.  Cold
+# runs drop the page, dentry and inode caches before each run, which needs
+# root; without it they are skipped and the report says so.
+#
+# The report only contains sorted keys and fixed-precision numbers, so two
+# reports can be compared with a plain diff or loaded by a script.
+import argparse
+import json
+import os
+import platform
+import re
+import statistics
+import subprocess
+import sys
+import time
+
+# (name, tree, arguments)
+CASES = [
+    ('single-column', 'flat', ['-1']),
+    ('columns', 'flat', ['--width=160']),
+    ('long', 'flat', ['-l']),
+    ('long-recursive', 'deep', ['-lR']),
+    ('natural-sort', 'flat', ['-1v']),
+    ('size-sort', 'flat', ['-1S']),
+    ('ignore', 'flat', ['-1', '--ignore=*.tmp', '--ignore=*[0-9][0-9]*.bak',
+                        '--ignore=lib-*-test*']),
+    ('icons', 'flat', ['-1', '--icons=always']),
+    ('unicode-columns', 'unicode', ['--width=160']),
+    ('unicode-long', 'unicode', ['-l']),
+    ('symlinks-long', 'symlinks/links', ['-l']),
+    ('owners-long', 'owners', ['-l']),
+]
+
+DROP_CACHES = '/proc/sys/vm/drop_caches'
+
+
+def can_drop_caches():
+    return os.access(DROP_CACHES, os.W_OK)
+
+
+def drop_caches():
+    os.sync()
+    with open(DROP_CACHES, 'w') as f:
+        f.write('3\n')
+
+
+def run_once(command, env):
+    """Runs `command` with its output discarded and returns its wall, user and
+    system time in seconds, its peak RSS in KiB and its exit status."""
+    with open(os.devnull, 'wb') as devnull:
+        start = time.perf_counter()
+        process = subprocess.Popen(command, stdout=devnull, stderr=devnull,
+                                   env=env)
+        _, status, usage = os.wait4(process.pid, 0)
+        wall = time.perf_counter() - start
+    process.returncode = os.waitstatus_to_exitcode(status)
+    return {
+        'wall': wall,
+        'user': usage.ru_utime,
+        'system': usage.ru_stime,
+        'max_rss_kib': usage.ru_maxrss,
+        'exit_status': process.returncode,
+    }
+
+
+def summarize(runs):
+    walls = [r['wall'] for r in runs]
+    return {
+        'runs': len(runs),
+        'wall': {
+            'min': round(min(walls), 6),
+            'median': round(statistics.median(walls), 6),
+            'mean': round(statistics.mean(walls), 6),
+            'stdev': round(statistics.stdev(walls), 6) if len(walls) > 1 else 0.0,
+            'samples': [round(w, 6) for w in walls],
+        },
+        'user': round(statistics.median(r['user'] for r in runs), 6),
+        'system': round(statistics.median(r['system'] for r in runs), 6),
+        'max_rss_kib': max(r['max_rss_kib'] for r in runs),
+        'exit_status': sorted({r['exit_status'] for r in runs}),
+    }
+
+
+def git_revision(lst):
+    try:
+        return subprocess.run(
+            ['git', 'describe', '--always', '--dirty'],
+            cwd=os.path.dirname(os.path.abspath(lst)), capture_output=True,
+            text=True, check=True).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Benchmark lst.')
+    parser.add_argument('lst')
+    parser.add_argument('trees')
+    parser.add_argument('--repeat', type=int, default=10,
+                        help='warm runs per case')
+    parser.add_argument('--cold', type=int, default=3,
+                        help='cold runs per case')
+    parser.add_argument('--only', default='',
+                        help='only run cases whose name matches this regex')
+    args = parser.parse_args()
+
+    try:
+        with open(os.path.join(args.trees, 'manifest.json')) as f:
+            manifest = json.load(f)
+    except OSError:
+        sys.exit('%s: no trees, run gen_tree.py first' % args.trees)
+
+    # Fixed environment so dates and names are formatted the same everywhere
+    env = {
+        'PATH': os.environ.get('PATH', '/usr/bin:/bin'),
+        'LC_ALL': 'C.UTF-8',
+        'TZ': 'UTC',
+    }
+    cold = args.cold if can_drop_caches() else 0
+
+    report = {
+        'format': 1,
+        'lst': os.path.abspath(args.lst),
+        'revision': git_revision(args.lst),
+        'host': {
+            'system': platform.system(),
+            'release': platform.release(),
+            'machine': platform.machine(),
+            'cpus': os.cpu_count(),
+        },
+        'trees': manifest,
+        'cold_runs': ('skipped: cannot write %s' % DROP_CACHES
+                      if args.cold and not cold else cold),
+        'cases': {},
+    }
+
+    only = re.compile(args.only)
+    for name, tree, lst_args in CASES:
+        if not only.search(name):
+            continue
+        path = os.path.join(args.trees, tree)
+        command = [args.lst] + lst_args + [path]
+        print('%-16s %s' % (name, ' '.join(lst_args)), file=sys.stderr)
+
+        run_once(command, env)
+        case = {
+            'tree': tree,
+            'args': lst_args,
+            'warm': summarize([run_once(command, env)
+                               for _ in range(args.repeat)]),
+        }
+        if cold:
+            runs = []
+            for _ in range(cold):
+                drop_caches()
+                runs.append(run_once(command, env))
+            case['cold'] = summarize(runs)
+        report['cases'][name] = case
+
+    json.dump(report, sys.stdout, indent=2, sort_keys=True)
+    sys.stdout.write('\n')
+
+
+if __name__ == '__main__':
+    main()
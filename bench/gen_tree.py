@@ -0,0 +1,194 @@
+#!/usr/bin/env python3
+# Generates the synthetic directory trees used by bench.py.  The trees only
+# depend on the seed and the scale, so runs on different machines list the
+# same names:
+#
+#   python3 bench/gen_tree.py [--scale=1.0] [--seed=1] DIRECTORY
+#
+# Every tree is recreated only if its parameters changed since the last run.
+import argparse
+import json
+import os
+import random
+import shutil
+import sys
+
+EXTENSIONS = ['', '.txt', '.md', '.c', '.cc', '.hh', '.py', '.png', '.jpg',
+              '.tar', '.gz', '.zip', '.mp3', '.mp4', '.so', '.o', '.bak',
+              '.tmp', '.1', '.2.3']
+
+WORDS = ['alpha', 'beta', 'gamma', 'delta', 'lib', 'test', 'data', 'build',
+         'release', 'config', 'file', 'image', 'v', 'part', 'log', 'cache']
+
+# Codepoint ranges for names: Latin-1 and Latin Extended, Greek, Cyrillic,
+# CJK, Hangul, combining marks and emoji.
+UNICODE_RANGES = [(0x00C0, 0x024F), (0x0391, 0x03C9), (0x0410, 0x044F),
+                  (0x4E00, 0x9FFF), (0xAC00, 0xD7A3), (0x0300, 0x036F),
+                  (0x1F600, 0x1F64F)]
+
+
+def ascii_name(rng, i):
+    """A file name like those in source trees, with version numbers so natural
+    sort has something to do."""
+    parts = [rng.choice(WORDS) for _ in range(rng.randint(1, 3))]
+    if rng.random() < 0.5:
+        parts.append(str(rng.randint(0, 2000)))
+    return '-'.join(parts) + '_%d' % i + rng.choice(EXTENSIONS)
+
+
+def unicode_name(rng, i):
+    chars = []
+    for _ in range(rng.randint(2, 24)):
+        lo, hi = rng.choice(UNICODE_RANGES)
+        chars.append(chr(rng.randint(lo, hi)))
+    # A combining mark must not start the name
+    if 0x0300 <= ord(chars[0]) <= 0x036F:
+        chars[0] = 'x'
+    return ''.join(chars) + '_%d' % i + rng.choice(EXTENSIONS)
+
+
+def touch(path, size):
+    with open(path, 'wb') as f:
+        if size:
+            # Sparse, only the size matters
+            f.truncate(size)
+
+
+def random_size(rng):
+    # Mostly small files with a long tail
+    return int(rng.paretovariate(1.2) * 512) if rng.random() < 0.9 else 0
+
+
+def set_time(rng, path):
+    # Spread over ten years so the date column uses both of its formats
+    t = 1_500_000_000 + rng.randint(0, 315_360_000)
+    os.utime(path, (t, t), follow_symlinks=False)
+
+
+def gen_flat(root, rng, scale):
+    """One directory with a million entries."""
+    for i in range(int(1_000_000 * scale)):
+        path = os.path.join(root, ascii_name(rng, i))
+        touch(path, random_size(rng))
+        set_time(rng, path)
+
+
+def gen_deep(root, rng, scale):
+    """A tree 12 levels deep with a few files and subdirectories per level."""
+    budget = [int(200_000 * scale)]
+
+    def fill(directory, depth):
+        for i in range(rng.randint(4, 16)):
+            if budget[0] <= 0:
+                return
+            budget[0] -= 1
+            path = os.path.join(directory, ascii_name(rng, i))
+            touch(path, random_size(rng))
+            set_time(rng, path)
+        if depth == 12:
+            return
+        for i in range(rng.randint(1, 4)):
+            sub = os.path.join(directory, 'dir-%d-%d' % (depth, i))
+            os.mkdir(sub)
+            fill(sub, depth + 1)
+
+    fill(root, 0)
+
+
+def gen_unicode(root, rng, scale):
+    """Names from many scripts, including double width and combining
+    characters, and some that are not valid UTF-8."""
+    for i in range(int(100_000 * scale)):
+        if rng.random() < 0.02:
+            name = b'bad\xff\xfe_%d' % i
+            path = os.path.join(os.fsencode(root), name)
+        else:
+            path = os.path.join(root, unicode_name(rng, i))
+        touch(path, random_size(rng))
+        set_time(rng, path)
+
+
+def gen_symlinks(root, rng, scale):
+    """Links to files, to directories, dangling links and chains of links."""
+    targets = os.path.join(root, 'targets')
+    links = os.path.join(root, 'links')
+    os.mkdir(targets)
+    os.mkdir(links)
+    count = int(100_000 * scale)
+    for i in range(max(count // 10, 1)):
+        touch(os.path.join(targets, 'file-%d' % i), random_size(rng))
+        if i % 100 == 0:
+            os.mkdir(os.path.join(targets, 'dir-%d' % i))
+    for i in range(count):
+        kind = rng.random()
+        if kind < 0.6:
+            target = '../targets/file-%d' % rng.randrange(max(count // 10, 1))
+        elif kind < 0.7:
+            target = '../targets/dir-%d' % (rng.randrange(max(count // 1000, 1)) * 100)
+        elif kind < 0.8:
+            target = 'missing-%d' % i
+        elif i > 0:
+            target = 'link-%d' % rng.randrange(i)
+        else:
+            target = 'link-0'
+        os.symlink(target, os.path.join(links, 'link-%d' % i))
+
+
+def gen_owners(root, rng, scale):
+    """Files owned by many users and groups, most of which have no passwd
+    entry.  Needs root; otherwise all files keep the current owner."""
+    can_chown = os.geteuid() == 0
+    for i in range(int(50_000 * scale)):
+        path = os.path.join(root, ascii_name(rng, i))
+        touch(path, 0)
+        if can_chown:
+            os.chown(path, 1000 + rng.randrange(500), 1000 + rng.randrange(500))
+    return {'chown': can_chown}
+
+
+TREES = {
+    'flat': gen_flat,
+    'deep': gen_deep,
+    'unicode': gen_unicode,
+    'symlinks': gen_symlinks,
+    'owners': gen_owners,
+}
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Generate the benchmark trees.')
+    parser.add_argument('directory')
+    parser.add_argument('--scale', type=float, default=1.0,
+                        help='multiplier for the number of entries')
+    parser.add_argument('--seed', type=int, default=1)
+    args = parser.parse_args()
+
+    os.makedirs(args.directory, exist_ok=True)
+    manifest_path = os.path.join(args.directory, 'manifest.json')
+    try:
+        with open(manifest_path) as f:
+            manifest = json.load(f)
+    except (OSError, ValueError):
+        manifest = {}
+
+    for name, generate in TREES.items():
+        params = {'scale': args.scale, 'seed': args.seed}
+        root = os.path.join(args.directory, name)
+        old = manifest.get(name, {})
+        if os.path.isdir(root) and old.get('scale') == args.scale \
+           and old.get('seed') == args.seed:
+            continue
+        print('generating %s' % root, file=sys.stderr)
+        shutil.rmtree(root, ignore_errors=True)
+        os.mkdir(root)
+        # Each tree has its own generator so changing one does not change the
+        # others.
+        rng = random.Random('%d-%s' % (args.seed, name))
+        params.update(generate(root, rng, args.scale) or {})
+        manifest[name] = params
+        with open(manifest_path, 'w') as f:
+            json.dump(manifest, f, indent=2, sort_keys=True)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,5 +1,6 @@
 #include "args.hh"
 #include "options.hh"
+#include "stats.hh"
 
 bool G_is_a_tty;
 
@@ -29,8 +30,14 @@ bool dereference = false;
 TimeMode time_mode = TimeMode::write;
 const char *time_format = nullptr;
 bool hyperlinks = false;
-arena::vector<std::string_view> ignore_patterns;
+PatternSet ignore_patterns;
 bool file_icons; // defaults to auto
+unsigned threads = 1;
+StatsMode stats_mode = StatsMode::off;
+const char *cache_dir = nullptr;
+const char *serve_socket = nullptr;
+const char *client_socket = nullptr;
+bool watch = false;
 }
 
 const char *G_program;
@@ -45,6 +52,13 @@ static def usage ()
   std::puts ("  -b, --escape          Print C-style escapes for nongraphic characters.");
   std::puts ("  -B, --ignore-backups  Do not list entries ending with '~', '.bak', or '.tmp'");
   std::puts ("  -c                    Use creation time for time.");
+  std::puts ("      --client=SOCKET   Have the server on SOCKET do the listing; list");
+  std::puts ("                          directly if there is none.  'lst-client SOCKET'");
+  std::puts ("                          does the same and starts faster.");
+  std::puts ("      --cache=DIR       Keep the status of listed entries in DIR and reuse it");
+  std::puts ("                          for directories that did not change since; a");
+  std::puts ("                          file changed in place keeps its old status until");
+  std::puts ("                          its directory changes.");
   std::puts ("      --color[=WHEN]    Colorize the output WHEN; more info below");
   std::puts ("  -d, --directory       Show directory names instead of contents.");
   std::puts ("  -D,                   Do not group directories before files.");
@@ -82,9 +96,17 @@ static def usage ()
   std::puts ("  -r, --reverse         Reverse sorting.");
   std::puts ("  -R, --recursive       List subdirectories recursively.");
   std::puts ("  -S                    Sort by file size, largest first.");
+  std::puts ("      --serve=SOCKET    Run a server for --client on SOCKET that keeps");
+  std::puts ("                          the directories it lists and watches them for");
+  std::puts ("                          changes; takes no other options.");
   std::puts ("      --sort=WORD       Sort by WORD instead of name: none (-U), time (-t),");
   std::puts ("                          size (-S), extension (-X), version (-v), width (-W).");
   std::puts ("      --case-sensitive  Do not ignore case when sorting by name or extension.");
+  std::puts ("      --threads[=N]     Use N threads to read directories with -R; without N,");
+  std::puts ("                          use one thread per CPU.");
+  std::puts ("      --stats[=json]    Print the time spent in each phase and counts of");
+  std::puts ("                          entries, system calls and lookups to stderr;");
+  std::puts ("                          only available if built with STATS=1.");
   std::puts ("  -t                    Sort y time, newest first.");
   std::puts ("      --time=WORD       Change the default of using modification times;");
   std::puts ("                          creation time (-c): creation, birth");
@@ -98,6 +120,8 @@ static def usage ()
   std::puts ("  -U                    Do not sort; list entries in directory order.");
   std::puts ("  -v                    Natural sort of version numbers within file names.");
   std::puts ("  -W                    Sort by file name width.");
+  std::puts ("      --watch           Keep listing the directories, redrawing the output");
+  std::puts ("                          whenever their entries change.");
   std::puts ("      --width=COLS      Set the output width for multi column output to COLS.");
   std::puts ("  -X                    Sort alphabetically by entry extension.");
   std::puts ("  -1                    List one file per line.");
@@ -292,7 +316,89 @@ static inline def handle_long_opt (std::string_view elem) -> bool
   else if (opt_name == "ignore"sv)
     {
       if (require_arg ()) return false;
-      Arguments::ignore_patterns.push_back (arg);
+      Arguments::ignore_patterns.add (arg);
+    }
+  else if (opt_name == "threads"sv)
+    {
+      if (arg.empty ())
+        Arguments::threads = std::max (std::thread::hardware_concurrency (), 1u);
+      else
+        {
+          // All threads are started up front, so there has to be a limit
+          let constexpr max_threads = 1024ul;
+          char *end = nullptr;
+          errno = 0;
+          let const n = std::strtoul (arg.data (), &end, 0);
+
+          if (n == 0 || n > max_threads || errno == ERANGE
+              || end != arg.data () + arg.size ())
+            {
+              std::fprintf (stderr, "%s: invalid argument ‘%.*s’ for ‘--%.*s’\n",
+                            G_program,
+                            static_cast<int> (arg.size ()), arg.data (),
+                            static_cast<int> (opt_name.size ()), opt_name.data ());
+              std::fprintf (stderr, "Argument must be an integer from 1 to %lu\n",
+                            max_threads);
+              return false;
+            }
+          Arguments::threads = static_cast<unsigned> (n);
+        }
+    }
+  else if (opt_name == "cache"sv)
+    {
+      if (require_arg ()) return false;
+#ifdef _WIN32
+      std::fprintf (stderr, "%s: ‘--cache’ is not available on Windows\n",
+                    G_program);
+      return false;
+#else
+      Arguments::cache_dir = arg.data ();
+#endif
+    }
+  else if (opt_name == "serve"sv || opt_name == "client"sv)
+    {
+      if (require_arg ()) return false;
+#ifdef __linux__
+      if (opt_name == "serve"sv)
+        Arguments::serve_socket = arg.data ();
+      else
+        Arguments::client_socket = arg.data ();
+#else
+      std::fprintf (stderr, "%s: ‘--%.*s’ is only available on Linux\n",
+                    G_program,
+                    static_cast<int> (opt_name.size ()), opt_name.data ());
+      return false;
+#endif
+    }
+  else if (opt_name == "watch"sv)
+    {
+#ifdef __linux__
+      Arguments::watch = true;
+#else
+      std::fprintf (stderr, "%s: ‘--watch’ is only available on Linux\n",
+                    G_program);
+      return false;
+#endif
+    }
+  else if (opt_name == "stats"sv)
+    {
+      if (!stats::enabled)
+        {
+          std::fprintf (stderr, "%s: ‘--stats’ is not available in this build"
+                        " (build with STATS=1)\n", G_program);
+          return false;
+        }
+      if (arg.empty ())
+        Arguments::stats_mode = StatsMode::text;
+      else if (arg == "json"sv)
+        Arguments::stats_mode = StatsMode::json;
+      else
+        {
+          invalid_arg ({
+            "  - ‘json’\n"
+          });
+          return false;
+        }
     }
   else if (opt_name == "icons"sv)
     {
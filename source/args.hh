@@ -1,5 +1,6 @@
 #pragma once
 #include "stdafx.hh"
+#include "match.hh"
 
 enum class SortMode
 {
@@ -26,6 +27,13 @@ enum class NongraphicMode
   show
 };
 
+enum class StatsMode
+{
+  off,
+  text,
+  json
+};
+
 enum class TimeMode
 {
   access,
@@ -100,8 +108,14 @@ extern bool dereference;
 extern TimeMode time_mode;
 extern const char *time_format;
 extern bool hyperlinks;
-extern arena::vector<std::string_view> ignore_patterns;
+extern PatternSet ignore_patterns;
 extern bool file_icons;
+extern unsigned threads;
+extern StatsMode stats_mode;
+extern const char *cache_dir;
+extern const char *serve_socket;
+extern const char *client_socket;
+extern bool watch;
 }
 
 def parse_args (int argc, const char **argv,
@@ -0,0 +1,308 @@
+#include "cache.hh"
+#include "args.hh"
+
+#ifndef _WIN32
+
+namespace cache
+{
+
+// A file is the header, `count` records and then the strings they refer to.
+// Everything is in the native layout, the cache is not meant to be shared
+// between machines.
+struct Header
+{
+  char magic[8];
+  std::uint32_t version;
+  // Catches layout differences between builds
+  std::uint32_t record_size;
+  std::uint64_t signature;
+  std::uint64_t dev;
+  std::uint64_t ino;
+  std::int64_t mtime_sec;
+  std::int64_t mtime_nsec;
+  std::int64_t ctime_sec;
+  std::int64_t ctime_nsec;
+  std::uint64_t count;
+  std::uint64_t strings_size;
+};
+
+struct Record
+{
+  struct stat sb;
+  std::uint64_t dev;
+  std::uint64_t ino;
+  // Offsets into the strings
+  std::uint32_t name;
+  std::uint32_t name_length;
+  std::uint32_t link_target;
+  std::uint32_t link_target_length;
+  std::uint32_t deref_target;
+  std::uint32_t deref_target_length;
+  std::int32_t error;
+  std::uint16_t in_perms;
+  std::uint16_t perms;
+  std::uint16_t link_target_perms;
+  std::int8_t in_type;
+  std::int8_t type;
+  std::int8_t link_target_type;
+  std::uint8_t is_directory;
+};
+
+static constexpr char S_magic[8] = {'l', 's', 't', 'c', 'a', 'c', 'h', 'e'};
+static constexpr std::uint32_t S_version = 1;
+
+static_assert (sizeof (Header) % alignof (Record) == 0);
+
+
+// Path of the cache file of a directory for the options making `signature`,
+// so listings with different options do not replace each other's file.
+static def file_of (const struct stat &dir_sb, std::uint64_t signature) -> std::string
+{
+  char name[64];
+  std::snprintf (name, sizeof (name), "/%llx-%llx-%llx",
+                 static_cast<unsigned long long> (dir_sb.st_dev),
+                 static_cast<unsigned long long> (dir_sb.st_ino),
+                 static_cast<unsigned long long> (signature));
+  return Arguments::cache_dir + std::string (name);
+}
+
+
+static def matches (const Header &h, const struct stat &dir_sb,
+                    std::uint64_t signature) -> bool
+{
+  return (std::memcmp (h.magic, S_magic, sizeof (S_magic)) == 0
+          && h.version == S_version
+          && h.record_size == sizeof (Record)
+          && h.signature == signature
+          && h.dev == static_cast<std::uint64_t> (dir_sb.st_dev)
+          && h.ino == static_cast<std::uint64_t> (dir_sb.st_ino)
+          && h.mtime_sec == dir_sb.st_mtim.tv_sec
+          && h.mtime_nsec == dir_sb.st_mtim.tv_nsec
+          && h.ctime_sec == dir_sb.st_ctim.tv_sec
+          && h.ctime_nsec == dir_sb.st_ctim.tv_nsec);
+}
+
+
+// Whether all strings of the records are inside the file, so a damaged file
+// can not make us read past the mapping.
+static def in_bounds (const Record *records, std::size_t count,
+                      std::uint64_t strings_size) -> bool
+{
+  let const fits = [strings_size](std::uint32_t offset, std::uint32_t length) {
+    return std::uint64_t (offset) + length <= strings_size;
+  };
+  for (std::size_t i = 0; i < count; ++i)
+    {
+      let const &r = records[i];
+      if (!fits (r.name, r.name_length)
+          || !fits (r.link_target, r.link_target_length)
+          || !fits (r.deref_target, r.deref_target_length))
+        return false;
+    }
+  return true;
+}
+
+
+Listing::Listing (const struct stat &dir_sb, std::uint64_t signature)
+{
+  let const fd = open (file_of (dir_sb, signature).c_str (), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return;
+  struct stat sb;
+  void *data = MAP_FAILED;
+  if (fstat (fd, &sb) == 0 && sb.st_size >= static_cast<off_t> (sizeof (Header)))
+    data = mmap (nullptr, sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (data == MAP_FAILED)
+    return;
+
+  M_data = static_cast<const char *> (data);
+  M_size = static_cast<std::size_t> (sb.st_size);
+  M_mapped = true;
+  if (!validate (dir_sb, signature))
+    {
+      munmap (data, M_size);
+      M_data = nullptr;
+    }
+}
+
+
+Listing::Listing (std::string_view data, const struct stat &dir_sb,
+                  std::uint64_t signature)
+  : M_data (data.data ())
+  , M_size (data.size ())
+{
+  if (M_size < sizeof (Header) || !validate (dir_sb, signature))
+    M_data = nullptr;
+}
+
+
+def Listing::validate (const struct stat &dir_sb, std::uint64_t signature) -> bool
+{
+  let const &h = *reinterpret_cast<const Header *> (M_data);
+  let const records = reinterpret_cast<const Record *> (M_data + sizeof (Header));
+  if (!matches (h, dir_sb, signature)
+      || h.count > (M_size - sizeof (Header)) / sizeof (Record)
+      || sizeof (Header) + h.count * sizeof (Record) + h.strings_size != M_size
+      || !in_bounds (records, h.count, h.strings_size))
+    return false;
+  M_count = h.count;
+  return true;
+}
+
+
+Listing::~Listing ()
+{
+  if (M_data && M_mapped)
+    munmap (const_cast<char *> (M_data), M_size);
+}
+
+
+def Listing::operator [] (std::size_t i) const -> Entry
+{
+  let const &r = reinterpret_cast<const Record *> (M_data + sizeof (Header))[i];
+  let const strings = M_data + sizeof (Header) + M_count * sizeof (Record);
+  return {
+    .name = {strings + r.name, r.name_length},
+    .in_type = static_cast<fs::file_type> (r.in_type),
+    .in_perms = static_cast<fs::perms> (r.in_perms),
+    .type = static_cast<fs::file_type> (r.type),
+    .perms = static_cast<fs::perms> (r.perms),
+    .error = r.error,
+    .sb = r.sb,
+    .link_target = {strings + r.link_target, r.link_target_length},
+    .link_target_type = static_cast<fs::file_type> (r.link_target_type),
+    .link_target_perms = static_cast<fs::perms> (r.link_target_perms),
+    .deref_target = {strings + r.deref_target, r.deref_target_length},
+    .is_directory = r.is_directory != 0,
+    .dev = static_cast<dev_t> (r.dev),
+    .ino = static_cast<ino_t> (r.ino),
+  };
+}
+
+
+// Writes all of `data` to `fd`
+static def write_all (int fd, std::string_view data) -> bool
+{
+  while (!data.empty ())
+    {
+      let const n = write (fd, data.data (), data.size ());
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      data.remove_prefix (static_cast<std::size_t> (n));
+    }
+  return true;
+}
+
+
+def serialize (const struct stat &dir_sb, std::uint64_t signature,
+               std::span<const Entry> entries) -> std::string
+{
+  std::string strings;
+  let const add_string = [&strings](std::string_view s) {
+    let const offset = static_cast<std::uint32_t> (strings.size ());
+    strings.append (s);
+    return offset;
+  };
+
+  std::string data (sizeof (Header) + entries.size () * sizeof (Record), '\0');
+  let const records = reinterpret_cast<Record *> (data.data () + sizeof (Header));
+  for (std::size_t i = 0; i < entries.size (); ++i)
+    {
+      let const &e = entries[i];
+      let &r = records[i];
+      r.sb = e.sb;
+      r.dev = static_cast<std::uint64_t> (e.dev);
+      r.ino = static_cast<std::uint64_t> (e.ino);
+      r.name = add_string (e.name);
+      r.name_length = static_cast<std::uint32_t> (e.name.size ());
+      r.link_target = add_string (e.link_target);
+      r.link_target_length = static_cast<std::uint32_t> (e.link_target.size ());
+      r.deref_target = add_string (e.deref_target);
+      r.deref_target_length = static_cast<std::uint32_t> (e.deref_target.size ());
+      r.error = e.error;
+      r.in_perms = static_cast<std::uint16_t> (e.in_perms);
+      r.perms = static_cast<std::uint16_t> (e.perms);
+      r.link_target_perms = static_cast<std::uint16_t> (e.link_target_perms);
+      r.in_type = static_cast<std::int8_t> (e.in_type);
+      r.type = static_cast<std::int8_t> (e.type);
+      r.link_target_type = static_cast<std::int8_t> (e.link_target_type);
+      r.is_directory = e.is_directory;
+    }
+  // Offsets would not fit
+  if (strings.size () > UINT32_MAX)
+    return {};
+
+  let &h = *reinterpret_cast<Header *> (data.data ());
+  std::memcpy (h.magic, S_magic, sizeof (S_magic));
+  h.version = S_version;
+  h.record_size = sizeof (Record);
+  h.signature = signature;
+  h.dev = static_cast<std::uint64_t> (dir_sb.st_dev);
+  h.ino = static_cast<std::uint64_t> (dir_sb.st_ino);
+  h.mtime_sec = dir_sb.st_mtim.tv_sec;
+  h.mtime_nsec = dir_sb.st_mtim.tv_nsec;
+  h.ctime_sec = dir_sb.st_ctim.tv_sec;
+  h.ctime_nsec = dir_sb.st_ctim.tv_nsec;
+  h.count = entries.size ();
+  h.strings_size = strings.size ();
+  data.append (strings);
+  return data;
+}
+
+
+def store (const struct stat &dir_sb, std::uint64_t signature,
+           std::string_view data) -> void
+{
+  // A directory changed within the resolution of its timestamps could change
+  // again without them changing, so it is only stored once it has been
+  // quiet for a moment.
+  if (data.empty () || dir_sb.st_ctim.tv_sec >= std::time (nullptr) - 1)
+    return;
+
+  // Written under a unique name and renamed into place, so readers never see
+  // a partial file.
+  static std::atomic<unsigned> S_counter = 0;
+  let const path = file_of (dir_sb, signature);
+  let const tmp = (path + '.' + std::to_string (getpid ()) + '.'
+                   + std::to_string (S_counter++) + ".tmp");
+  let fd = open (tmp.c_str (), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if (fd == -1 && errno == ENOENT)
+    {
+      std::error_code ec;
+      fs::create_directories (Arguments::cache_dir, ec);
+      fd = open (tmp.c_str (), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    }
+  if (fd == -1)
+    return;
+  let const ok = write_all (fd, data);
+  close (fd);
+  if (!ok || rename (tmp.c_str (), path.c_str ()) == -1)
+    unlink (tmp.c_str ());
+}
+
+
+def identity (const struct stat &dir_sb, std::uint64_t signature) -> Identity
+{
+  return { static_cast<std::uint64_t> (dir_sb.st_dev),
+           static_cast<std::uint64_t> (dir_sb.st_ino), signature };
+}
+
+
+def identity (std::string_view data) -> std::optional<Identity>
+{
+  if (data.size () < sizeof (Header))
+    return std::nullopt;
+  Header h;
+  std::memcpy (&h, data.data (), sizeof (h));
+  if (std::memcmp (h.magic, S_magic, sizeof (S_magic)) != 0
+      || h.version != S_version)
+    return std::nullopt;
+  return Identity { h.dev, h.ino, h.signature };
+}
+
+}
+
+#endif // !_WIN32
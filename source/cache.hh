@@ -0,0 +1,104 @@
+#pragma once
+#include "stdafx.hh"
+
+#ifndef _WIN32
+
+// The on-disk metadata cache of --cache=DIR.  Every listed directory gets a
+// file in DIR holding the status of all its entries, named after its device
+// and inode number and the signature of the options that affect what is
+// stored.  The file also records the modification and change time the
+// directory had when it was read, so a single stat of the directory tells
+// whether the file can be used.
+//
+// Only changes to the directory itself are noticed: an entry being created,
+// removed or renamed updates the directory's times, but a file that is
+// written to or has its permissions changed keeps its cached status until the
+// directory changes for some other reason.
+namespace cache
+{
+
+// The cached status of a directory entry.  Strings point into the mapped
+// file, or into the FileStatus an entry was made from.
+struct Entry
+{
+  std::string_view name;
+  fs::file_type in_type;
+  fs::perms in_perms;
+  fs::file_type type;
+  fs::perms perms;
+  // errno of the failed stat call, or 0
+  int error;
+  struct stat sb;
+  std::string_view link_target;
+  fs::file_type link_target_type;
+  fs::perms link_target_perms;
+  std::string_view deref_target;
+  // Whether -R descends into the entry; for symlinks `dev` and `ino` identify
+  // the directory it points to.
+  bool is_directory;
+  dev_t dev;
+  ino_t ino;
+};
+
+// The cached entries of a directory
+class Listing
+{
+public:
+  // Maps the file of the directory described by `dir_sb`.  The listing is
+  // empty if there is none, if it was written with a different `signature`
+  // or if the directory changed since.
+  Listing (const struct stat &dir_sb, std::uint64_t signature);
+
+  // Like above for `data` as made by `serialize`, which must outlive the
+  // listing.
+  Listing (std::string_view data, const struct stat &dir_sb,
+           std::uint64_t signature);
+
+  Listing (const Listing &) = delete;
+
+  ~Listing ();
+
+  explicit operator bool () const { return M_data != nullptr; }
+
+  def size () const -> std::size_t { return M_count; }
+
+  def operator [] (std::size_t i) const -> Entry;
+
+private:
+  def validate (const struct stat &dir_sb, std::uint64_t signature) -> bool;
+
+  const char *M_data {nullptr};
+  std::size_t M_size {0};
+  std::size_t M_count {0};
+  bool M_mapped {false};
+};
+
+// The contents of the cache file of the directory described by `dir_sb`,
+// which must be its status from before it was read.
+def serialize (const struct stat &dir_sb, std::uint64_t signature,
+               std::span<const Entry> entries) -> std::string;
+
+// Writes `data` made by `serialize` for the directory described by `dir_sb`
+// and `signature` to its file.  Errors are ignored, the directory is just
+// read again next time.
+def store (const struct stat &dir_sb, std::uint64_t signature,
+           std::string_view data) -> void;
+
+// What a cache file is for: a directory and the signature of the arguments
+struct Identity
+{
+  std::uint64_t dev;
+  std::uint64_t ino;
+  std::uint64_t signature;
+
+  def operator <=> (const Identity &) const = default;
+};
+
+def identity (const struct stat &dir_sb, std::uint64_t signature) -> Identity;
+
+// The identity of `data` made by `serialize`, if it is one
+def identity (std::string_view data) -> std::optional<Identity>;
+
+}
+
+#endif // !_WIN32
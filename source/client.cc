@@ -0,0 +1,149 @@
+#include "client.hh"
+
+#ifdef __linux__
+
+namespace client
+{
+
+def read_all (int fd, void *data, std::size_t size) -> bool
+{
+  let p = static_cast<char *> (data);
+  while (size)
+    {
+      let const n = read (fd, p, size);
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= static_cast<std::size_t> (n);
+    }
+  return true;
+}
+
+
+def send_all (int fd, const void *data, std::size_t size) -> bool
+{
+  let p = static_cast<const char *> (data);
+  while (size)
+    {
+      let const n = send (fd, p, size, MSG_NOSIGNAL);
+      if (n == -1 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        return false;
+      p += n;
+      size -= static_cast<std::size_t> (n);
+    }
+  return true;
+}
+
+
+def socket_address (const char *path, sockaddr_un &addr) -> bool
+{
+  addr = {};
+  addr.sun_family = AF_UNIX;
+  if (std::strlen (path) >= sizeof (addr.sun_path))
+    return false;
+  std::strcpy (addr.sun_path, path);
+  return true;
+}
+
+
+// Whether the argument is left out of the request
+static def skipped (const char *arg) -> bool
+{
+  return std::strncmp (arg, "--client=", 9) == 0;
+}
+
+
+def request (const char *path, int argc, const char **argv) -> std::optional<int>
+{
+  sockaddr_un addr;
+  if (!socket_address (path, addr))
+    {
+      std::fprintf (stderr, "%s: socket path too long: %s\n", argv[0], path);
+      return std::nullopt;
+    }
+  let const fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd == -1)
+    return std::nullopt;
+  let const cwd = open (".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (cwd == -1
+      || connect (fd, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) == -1)
+    {
+      if (cwd != -1)
+        close (cwd);
+      close (fd);
+      return std::nullopt;
+    }
+
+  // The length goes in front of the strings so they are sent at once
+  let const tz = std::getenv ("TZ");
+  std::size_t size = sizeof (std::uint32_t) + (tz ? std::strlen (tz) + 2 : 1);
+  for (let i = 0; i < argc; ++i)
+    if (!i || !skipped (argv[i]))
+      size += std::strlen (argv[i]) + 1;
+  let const buf = static_cast<char *> (std::malloc (size));
+  if (!buf)
+    {
+      close (cwd);
+      close (fd);
+      return std::nullopt;
+    }
+  let const length = static_cast<std::uint32_t> (size - sizeof (std::uint32_t));
+  std::memcpy (buf, &length, sizeof (length));
+  let p = buf + sizeof (length);
+  if (tz)
+    {
+      *p++ = '=';
+      p = stpcpy (p, tz);
+    }
+  *p++ = '\0';
+  for (let i = 0; i < argc; ++i)
+    if (!i || !skipped (argv[i]))
+      p = stpcpy (p, argv[i]) + 1;
+
+  int fds[3] = { STDOUT_FILENO, STDERR_FILENO, cwd };
+  iovec iov { buf, size };
+  alignas (cmsghdr) char control[CMSG_SPACE (sizeof (fds))] = {};
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+  let const cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (fds));
+  std::memcpy (CMSG_DATA (cmsg), fds, sizeof (fds));
+
+  // The file descriptors go with the first byte, the rest may take more
+  // than one write.
+  let const first = sendmsg (fd, &msg, MSG_NOSIGNAL);
+  let const sent = (first > 0
+                    && send_all (fd, buf + first,
+                                 size - static_cast<std::size_t> (first)));
+  std::free (buf);
+  close (cwd);
+  int status;
+  if (!sent)
+    {
+      close (fd);
+      return std::nullopt;
+    }
+  if (!read_all (fd, &status, sizeof (status)))
+    {
+      std::fprintf (stderr, "%s: the server did not finish the listing\n",
+                    argv[0]);
+      status = 2;
+    }
+  close (fd);
+  if (status == not_served)
+    return std::nullopt;
+  return status;
+}
+
+}
+
+#endif // __linux__
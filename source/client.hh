@@ -0,0 +1,37 @@
+#pragma once
+#include "stdafx.hh"
+
+// The client of --client and the lst-client program.  A request is the
+// length of the strings, the value of TZ prefixed with '=' or an empty
+// string if it is not set, and the arguments, all null terminated.  It comes
+// with the client's stdout, stderr and working directory, passed as file
+// descriptors, and is answered with the exit status of the listing.
+//
+// Only the C library is used here, so lst-client can be linked without the
+// C++ runtime, whose start-up takes longer than a listing the server keeps.
+namespace client
+{
+
+#ifdef __linux__
+
+// The answer to a request the server leaves to the client, like --watch
+inline constexpr int not_served = -1;
+
+// Sends the request to the server at `path` and waits for it to finish.
+// Returns the exit status of the listing, or nullopt if there is no server
+// or it did not take the request, so the caller can list by itself.
+def request (const char *path, int argc, const char **argv) -> std::optional<int>;
+
+// Reads all of `size` bytes, false if the connection ends first
+def read_all (int fd, void *data, std::size_t size) -> bool;
+
+// Writes all of `data` to the socket `fd`; a closed connection is an error
+// instead of a SIGPIPE.
+def send_all (int fd, const void *data, std::size_t size) -> bool;
+
+// False if `path` does not fit a socket address
+def socket_address (const char *path, sockaddr_un &addr) -> bool;
+
+#endif
+
+}
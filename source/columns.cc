@@ -1,9 +1,13 @@
 #include "columns.hh"
+#include "output.hh"
+#include "stats.hh"
 
 unsigned G_term_height;
 
 Columns::Columns ()
-  : M_columns {}
+  : M_elems {}
+  , M_max {}
+  , M_widths {}
   , M_rows (1)
   , M_has_quoted (false)
   , M_single_column (false)
@@ -18,144 +22,111 @@ def Columns::add (const FileInfo *f) -> void
                          && (f->name.front () == '\'' || f->name.front () == '"')
                          && (f->name.front () == f->name.back ()));
 
-  if (M_single_column || (unsigned)width+2 >= Arguments::width)
-    {
-      if (!M_single_column)
-        {
-          M_rows = (std::size_t)-1;
-          this->reorder ();
-          M_single_column = true;
-        }
-      M_columns[0].add(f, width, is_quoted);
-      return;
-    }
+  M_elems.emplace_back (f, width, is_quoted);
 
-  let c = std::find_if (M_columns.begin (), M_columns.end (), [&](const Column &c){
-    return c.elems.size () < M_rows;
-  });
+  // A name that does not fit next to any other puts everything in a single
+  // column; quoted names after it no longer shift the others.
+  if (M_single_column || (unsigned)width+2 >= Arguments::width)
+    M_single_column = true;
+  else if (is_quoted)
+    M_has_quoted = true;
+}
 
-  if (c == M_columns.end ())
+def Columns::max_width (std::size_t begin, std::size_t end) -> unsigned
+{
+  let level = std::size_t (0);
+  while ((std::size_t (2) << level) <= end - begin)
+    ++level;
+  while (M_max.size () <= level)
     {
-      M_columns.emplace_back ().add (f, width, is_quoted);
+      // Level k covers 2^k elements, built from two halves of level k-1
+      let const &prev = M_max.back ();
+      let const half = std::size_t (1) << (M_max.size () - 1);
+      arena::vector<unsigned> next (prev.size () - half);
+      for (std::size_t i = 0; i < next.size (); ++i)
+        next[i] = std::max (prev[i], prev[i + half]);
+      M_max.push_back (std::move (next));
     }
-  else
+  let const &m = M_max[level];
+  return std::max (m[begin], m[end - (std::size_t (1) << level)]);
+}
+
+def Columns::layout () -> void
+{
+  stats::Timer timer (stats::layout);
+  let const n = M_elems.size ();
+  if (M_single_column)
     {
-      c->add (f, width, is_quoted);
+      M_rows = n;
+      // don't print superfluous padding, this is would add empty lines between
+      // all the elements that aren't wider than the terminal width.
+      M_widths.assign (1, 0);
+      return;
     }
 
-  if (is_quoted)
-    M_has_quoted = true;
+  M_max.clear ();
+  let &level0 = M_max.emplace_back ();
+  level0.reserve (n);
+  for (let const &e : M_elems)
+    level0.push_back (e.width - e.is_quoted);
 
-  if (this->total_width () >= Arguments::width)
+  let const sep = 2 + M_has_quoted;
+  // Every row count is tried in order; a row count that does not fit is
+  // usually given up after a few columns, so this stays close to linear.
+  for (M_rows = 1; M_rows < n; ++M_rows)
     {
-      ++M_rows;
-      this->reorder ();
-      while (this->total_width () >= Arguments::width)
+      let total = std::uint64_t (0);
+      for (std::size_t begin = 0; begin < n && total < Arguments::width;
+           begin += M_rows)
         {
-          ++M_rows;
-          this->reorder ();
+          if (begin)
+            total += sep;
+          total += max_width (begin, std::min (begin + M_rows, n));
         }
-      M_columns.erase (
-        std::remove_if (
-          M_columns.begin (),
-          M_columns.end (),
-          [](const Column &col) {
-            return col.elems.empty ();
-          }
-        ),
-        M_columns.end ()
-      );
+      if (total < Arguments::width)
+        break;
     }
+
+  M_widths.clear ();
+  for (std::size_t begin = 0; begin < n; begin += M_rows)
+    M_widths.push_back (max_width (begin, std::min (begin + M_rows, n)));
+  M_max.clear ();
 }
 
 def Columns::print () -> void
 {
-  if (M_single_column)
-    {
-      // don't print eighteen quintillion rows
-      M_rows = M_columns[0].elems.size();
-      // don't print superfluous padding, this is would add empty lines between
-      // all the elements that aren't wider than the terminal width.
-      M_columns[0].width = 0;
-    }
+  layout ();
+  let const n = M_elems.size ();
+  let const columns = M_widths.size ();
   std::size_t r, c;
   for (r = 0; r < M_rows; ++r)
     {
-      for (c = 0; c < M_columns.size (); ++c)
+      for (c = 0; c < columns; ++c)
         {
-          let const is_not_last = (c + 1) < M_columns.size ();
-          let const &col = M_columns[c];
-          let const &elem = col.elems[r];
-          if (r >= col.elems.size ())
+          let const is_not_last = (c + 1) < columns;
+          let const i = c * M_rows + r;
+          if (i >= n)
             break;
+          let const &elem = M_elems[i];
+          let const width = M_widths[c];
           if (elem.file->status_failed && Arguments::color)
-            std::fputs ("\x1b[2m", stdout);
+            G_out.put ("\x1b[2m");
           if (M_has_quoted)
-            print_file_name (*elem.file, M_has_quoted, (col.width + elem.is_quoted) * is_not_last);
+            print_file_name (*elem.file, M_has_quoted, (width + elem.is_quoted) * is_not_last);
           else
-            print_file_name (*elem.file, M_has_quoted, col.width * is_not_last);
+            print_file_name (*elem.file, M_has_quoted, width * is_not_last);
           if (elem.file->status_failed && Arguments::color)
-            std::fputs ("\x1b[22m", stdout);
+            G_out.put ("\x1b[22m");
           if (is_not_last)
             {
-              std::putchar (' ');
-              std::putchar (' ');
+              G_out.put (' ');
+              G_out.put (' ');
             }
         }
       if (Arguments::file_icons && G_is_a_tty
-          && M_rows >= G_term_height && r+1 == M_rows && c+1 == M_columns.size ())
-        std::fputs ("\x1b[2m...\n\x1b[0m", stdout);
+          && M_rows >= G_term_height && r+1 == M_rows && c+1 == columns)
+        G_out.put ("\x1b[2m...\n\x1b[0m");
       else
-        std::putchar ('\n');
-    }
-}
-
-def Columns::total_width () const -> std::uint64_t
-{
-  let w = 0ull;
-  for (let const &c : M_columns)
-    w += c.width;
-  w += (M_columns.size () - 1) * (2 + M_has_quoted);
-  return w;
-}
-
-def Columns::new_column_count () const -> std::size_t
-{
-  let const o = M_columns.size ();
-  let const old_cap = o * (M_rows - 1);
-  let n = o / 2;
-  let const new_cap = n * M_rows;
-  n += (int)std::ceil ((float)(old_cap - new_cap) / M_rows);
-  return n;
-}
-
-def Columns::reorder () -> void
-{
-  let cols = this->new_column_count ();
-
-  let new_columns = arena::vector<Column> {};
-  for (std::size_t i = 0; i < cols; ++i)
-    new_columns.emplace_back ();
-
-  let idx = std::make_pair (std::size_t {0}, std::size_t {0});
-  for (let const &col : M_columns)
-    {
-      for (let const &elem : col.elems)
-        {
-          new_columns[idx.first].add (elem);
-          this->next (idx);
-        }
-    }
-
-  M_columns.swap (new_columns);
-}
-
-def Columns::next (std::pair<std::size_t, std::size_t> &idx) -> void
-{
-  ++idx.second;
-  if (idx.second == M_rows)
-    {
-      ++idx.first;
-      idx.second = 0;
+        G_out.put ('\n');
     }
 }
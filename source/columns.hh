@@ -4,6 +4,9 @@
 
 extern unsigned G_term_height;
 
+// Lays out file names in columns, filled top to bottom, using as few rows as
+// possible.  All names are collected first and the layout is done once in
+// print.
 class Columns
 {
   struct Element
@@ -17,30 +20,6 @@ class Columns
     {}
   };
 
-  struct Column
-  {
-    arena::vector<Element> elems;
-    unsigned width;
-
-    Column ()
-      : elems {}, width (0)
-    {}
-
-    def add (const Element &elem) -> void
-    {
-      elems.push_back (elem);
-      if ((elem.width - elem.is_quoted) > width)
-        width = elem.width - elem.is_quoted;
-    }
-
-    def add (const FileInfo *f, unsigned w, bool q)
-    {
-      elems.emplace_back (f, w, q);
-      if ((w - q) > width)
-        width = w - q;
-    }
-  };
-
 public:
   Columns ();
 
@@ -49,18 +28,20 @@ public:
   def print () -> void;
 
 private:
-  def total_width () const -> std::uint64_t;
-
-  def new_column_count () const -> std::size_t;
-
-  def reorder () -> void;
+  // Finds the smallest row count that fits the terminal width and sets
+  // M_rows and M_widths for it.
+  def layout () -> void;
 
-  // Set `idx` to the column/row index of the next cell
-  // idx.first -> col, idx.second -> row
-  def next (std::pair<std::size_t, std::size_t> &idx) -> void;
+  // Widest element in [begin, end); uses the sparse table in M_max.
+  def max_width (std::size_t begin, std::size_t end) -> unsigned;
 
 private:
-  arena::vector<Column> M_columns;
+  arena::vector<Element> M_elems;
+  // M_max[k][i] is the widest element in [i, i + 2^k); levels are built as
+  // the row count grows.
+  arena::vector<arena::vector<unsigned>> M_max;
+  // Widths of the columns of the chosen layout
+  arena::vector<unsigned> M_widths;
   std::size_t M_rows;
   bool M_has_quoted;
   bool M_single_column;
@@ -0,0 +1,161 @@
+#pragma once
+#include "stdafx.hh"
+
+// File name extensions with a special meaning for icons, colors or file
+// types.  The table is a perfect hash built at compile time: extensions are
+// packed into a 64-bit key and a multiplier is searched for that maps every
+// known key to its own slot, so a lookup is one multiplication and one
+// comparison.
+namespace extension
+{
+
+enum class Kind : std::uint8_t
+{
+  none,
+  text,
+  image,
+  video,
+  audio,
+  archive,
+  temporary,
+  // Only meaningful on Windows
+  executable,
+  shortcut,
+};
+
+// The extension of `name` including the dot, empty for names without one and
+// for hidden files like ".bashrc"
+constexpr def of (std::string_view name) -> std::string_view
+{
+  if (name == "."sv || name == ".."sv)
+    return {};
+  let const dot = name.rfind ('.');
+  if (dot == std::string_view::npos || dot == 0)
+    return {};
+  return name.substr (dot);
+}
+
+namespace detail
+{
+
+struct Entry
+{
+  std::string_view extension;
+  Kind kind;
+};
+
+constexpr Entry entries[] = {
+  { ".txt"sv, Kind::text },
+  { ".md"sv, Kind::text },
+  { ".jpg"sv, Kind::image },
+  { ".jpeg"sv, Kind::image },
+  { ".jfif"sv, Kind::image },
+  { ".bmp"sv, Kind::image },
+  { ".png"sv, Kind::image },
+  { ".ppm"sv, Kind::image },
+  { ".tif"sv, Kind::image },
+  { ".tiff"sv, Kind::image },
+  { ".gif"sv, Kind::image },
+  { ".svg"sv, Kind::image },
+  { ".mp4"sv, Kind::video },
+  { ".webm"sv, Kind::video },
+  { ".mov"sv, Kind::video },
+  { ".mp3"sv, Kind::audio },
+  { ".wav"sv, Kind::audio },
+  { ".zip"sv, Kind::archive },
+  { ".7z"sv, Kind::archive },
+  { ".tar"sv, Kind::archive },
+  { ".gz"sv, Kind::archive },
+  { ".bz2"sv, Kind::archive },
+  { ".tmp"sv, Kind::temporary },
+  { ".bak"sv, Kind::temporary },
+  { ".exe"sv, Kind::executable },
+  { ".bat"sv, Kind::executable },
+  { ".cmd"sv, Kind::executable },
+  { ".lnk"sv, Kind::shortcut },
+};
+
+constexpr std::size_t max_length = 8;
+constexpr unsigned table_bits = 7;
+constexpr std::size_t table_size = std::size_t (1) << table_bits;
+
+// The bytes of `ext` in little endian order.  File names cannot contain null
+// bytes, so no two extensions of at most 8 bytes have the same key.
+constexpr def key (std::string_view ext) -> std::uint64_t
+{
+  let k = std::uint64_t (0);
+  for (std::size_t i = 0; i < ext.size (); ++i)
+    k |= std::uint64_t (static_cast<unsigned char> (ext[i])) << (i * 8);
+  return k;
+}
+
+constexpr def slot (std::uint64_t key, std::uint64_t multiplier) -> std::size_t
+{
+  return static_cast<std::size_t> ((key * multiplier) >> (64 - table_bits));
+}
+
+constexpr def find_multiplier () -> std::uint64_t
+{
+  // Odd candidates from a simple linear congruential generator
+  let candidate = std::uint64_t (0x9e3779b97f4a7c15);
+  for (let attempt = 0; attempt < 10000; ++attempt)
+    {
+      candidate = candidate * 6364136223846793005ULL + 1442695040888963407ULL;
+      let const multiplier = candidate | 1;
+      bool used[table_size] = {};
+      bool ok = true;
+      for (let const &e : entries)
+        {
+          let const s = slot (key (e.extension), multiplier);
+          if (used[s])
+            {
+              ok = false;
+              break;
+            }
+          used[s] = true;
+        }
+      if (ok)
+        return multiplier;
+    }
+  return 0;
+}
+
+constexpr std::uint64_t multiplier = find_multiplier ();
+static_assert (multiplier != 0, "no perfect hash for the extension table");
+
+struct Table
+{
+  std::uint64_t keys[table_size];
+  Kind kinds[table_size];
+};
+
+constexpr def build () -> Table
+{
+  Table t {};
+  for (let const &e : entries)
+    {
+      let const k = key (e.extension);
+      t.keys[slot (k, multiplier)] = k;
+      t.kinds[slot (k, multiplier)] = e.kind;
+    }
+  return t;
+}
+
+constexpr Table table = build ();
+
+}
+
+// The kind of the extension `ext` as returned by `of`
+constexpr def lookup (std::string_view ext) -> Kind
+{
+  if (ext.size () < 2 || ext.size () > detail::max_length)
+    return Kind::none;
+  let const k = detail::key (ext);
+  let const s = detail::slot (k, detail::multiplier);
+  return detail::table.keys[s] == k ? detail::table.kinds[s] : Kind::none;
+}
+
+static_assert (lookup (".tar"sv) == Kind::archive);
+static_assert (lookup (".ta"sv) == Kind::none);
+
+}
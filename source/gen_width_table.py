@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Generates width_table.hh, the display widths of all codepoints, from the
+# Unicode database bundled with Python:
+#
+#   python3 source/gen_width_table.py > source/width_table.hh
+import sys
+import unicodedata
+
+BLOCK = 256
+# Widths are packed 4 per byte
+PACK = 4
+
+
+def width(cp):
+    if cp == 0:
+        return 0
+    # Hangul Jamo medial vowels and final consonants combine with the
+    # preceding initial consonant.
+    if 0x1160 <= cp <= 0x11FF or 0xD7B0 <= cp <= 0xD7FF:
+        return 0
+    if 0xD800 <= cp <= 0xDFFF:
+        return 1
+    c = chr(cp)
+    category = unicodedata.category(c)
+    if category in ('Mn', 'Me') or (category == 'Cf' and cp != 0x00AD):
+        return 0
+    if cp == 0x200B:
+        return 0
+    # Emoji with a default emoji presentation are East Asian Wide as well
+    if unicodedata.east_asian_width(c) in ('W', 'F'):
+        return 2
+    # Unassigned codepoints of the ideographic planes
+    if 0x20000 <= cp <= 0x2FFFD or 0x30000 <= cp <= 0x3FFFD:
+        return 2
+    return 1
+
+
+def main():
+    blocks = []
+    block_index = {}
+    stage1 = []
+    for start in range(0, 0x110000, BLOCK):
+        packed = []
+        for i in range(0, BLOCK, PACK):
+            byte = 0
+            for j in range(PACK):
+                byte |= width(start + i + j) << (2 * j)
+            packed.append(byte)
+        packed = tuple(packed)
+        if packed not in block_index:
+            block_index[packed] = len(blocks)
+            blocks.append(packed)
+        stage1.append(block_index[packed])
+    assert len(blocks) <= 256
+
+    out = sys.stdout
+    out.write('// Generated by gen_width_table.py from Unicode %s, do not edit.\n'
+              % unicodedata.unidata_version)
+    out.write('#pragma once\n#include "stdafx.hh"\n\n')
+    out.write('namespace unicode::width_table\n{\n\n')
+    out.write('constexpr std::size_t block_size = %d;\n\n' % BLOCK)
+    out.write('// Block of each group of %d codepoints\n' % BLOCK)
+    out.write('constexpr std::uint8_t stage1[%d] = {\n' % len(stage1))
+    for i in range(0, len(stage1), 16):
+        out.write('  ' + ', '.join('%d' % b for b in stage1[i:i + 16]) + ',\n')
+    out.write('};\n\n')
+    out.write('// Widths of the codepoints of a block, 2 bits each\n')
+    out.write('constexpr std::uint8_t stage2[%d][%d] = {\n' % (len(blocks), BLOCK // PACK))
+    for block in blocks:
+        out.write('  {\n')
+        for i in range(0, len(block), 16):
+            out.write('    ' + ', '.join('0x%02x' % b for b in block[i:i + 16]) + ',\n')
+        out.write('  },\n')
+    out.write('};\n\n}\n')
+
+
+if __name__ == '__main__':
+    main()
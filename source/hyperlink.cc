@@ -0,0 +1,96 @@
+#include "hyperlink.hh"
+#include "unicode.hh"
+
+namespace hyperlink
+{
+
+// Directory the cached prefix belongs to, as given by the caller
+static fs::path S_directory;
+static bool S_have_prefix = false;
+// "file://host/canonical/directory/"
+static arena::string S_prefix;
+static arena::string S_uri;
+
+static def append_encoded (std::string_view str, bool is_path, arena::string &out)
+{
+  static constexpr char hex_digits[] = "0123456789ABCDEF";
+  for (let const c : str)
+    {
+      let const u = static_cast<unsigned char> (c);
+      if ((u >= 'a' && u <= 'z') || (u >= 'A' && u <= 'Z') || (u >= '0' && u <= '9')
+          || c == '-' || c == '.' || c == '_' || c == '~'
+          || (is_path && (c == '/' || c == ':')))
+        out.push_back (c);
+      else
+        {
+          out.push_back ('%');
+          out.push_back (hex_digits[u >> 4]);
+          out.push_back (hex_digits[u & 15]);
+        }
+    }
+}
+
+static def hostname () -> std::string_view
+{
+  static arena::string S_hostname;
+  static bool first_call = true;
+  if (first_call)
+    {
+      char buf[256] = {};
+#ifdef _WIN32
+      DWORD size = sizeof (buf);
+      if (!GetComputerNameA (buf, &size))
+        buf[0] = '\0';
+#else
+      if (gethostname (buf, sizeof (buf) - 1) != 0)
+        buf[0] = '\0';
+#endif
+      append_encoded (buf, false, S_hostname);
+      first_call = false;
+    }
+  return S_hostname;
+}
+
+static def set_directory (const fs::path &directory) -> void
+{
+  if (S_have_prefix && S_directory == directory)
+    return;
+  S_directory = directory;
+  S_have_prefix = true;
+
+  std::error_code error;
+  let canonical = fs::weakly_canonical (directory, error);
+  if (error)
+    canonical = directory;
+  let path = unicode::path_to_str (canonical);
+#ifdef _WIN32
+  std::replace (path.begin (), path.end (), '\\', '/');
+#endif
+
+  S_prefix.assign ("file://"sv);
+  S_prefix.append (hostname ());
+  if (path.empty () || path.front () != '/')
+    S_prefix.push_back ('/');
+  append_encoded (path, true, S_prefix);
+  if (S_prefix.back () != '/')
+    S_prefix.push_back ('/');
+}
+
+def file_uri (const FileInfo &f) -> std::string_view
+{
+  // Link targets may have more than one component
+  let const name = f.file_name ();
+  let const parent = std::string_view (f._path).substr (0, f._path.size () - name.size ());
+  if (!f._directory)
+    set_directory (unicode::str_to_path (parent.empty () ? "."sv : parent));
+  else if (parent.empty ())
+    set_directory (*f._directory);
+  else
+    set_directory (*f._directory / unicode::str_to_path (parent));
+
+  S_uri.assign (S_prefix);
+  append_encoded (name, false, S_uri);
+  return S_uri;
+}
+
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "lst.hh"
+
+// OSC 8 hyperlinks to listed files.  The canonical path of a directory is
+// resolved and percent-encoded once; the URI of each entry is that prefix
+// plus its encoded name.
+namespace hyperlink
+{
+
+// The file:// URI of `f`, valid until the next call
+def file_uri (const FileInfo &f) -> std::string_view;
+
+}
@@ -1,19 +1,18 @@
 #include "lst.hh"
+#include "cache.hh"
 #include "columns.hh"
+#include "hyperlink.hh"
 #include "match.hh"
 #include "natural_sort.hh"
-
-#ifdef _WIN32
-static const fs::path S_lnk_ext { L".lnk"s };
-static const fs::path S_exe_ext { L".exe"s };
-static const fs::path S_bat_ext { L".bat"s };
-static const fs::path S_cmd_ext { L".cmd"s };
-static const fs::path S_bak_ext { L".bak"s };
-static const fs::path S_tmp_ext { L".tmp"s };
-#else
-static const fs::path S_bak_ext { ".bak"s };
-static const fs::path S_tmp_ext { ".tmp"s };
-#endif
+#include "output.hh"
+#include "owners.hh"
+#include "quoting.hh"
+#include "radix_sort.hh"
+#include "server.hh"
+#include "stats.hh"
+#include "thread_pool.hh"
+#include "timestamp.hh"
+#include "uring.hh"
 
 std::time_t G_six_months_ago;
 
@@ -24,11 +23,9 @@ static std::error_code S_ec;
 static bool S_did_complain;
 
 #ifdef _WIN32
-static std::map<PSID, arena::string> G_users;
-static std::map<PSID, arena::string> G_groups;
-#else
-std::map<pid_t, arena::string> G_users;
-std::map<uid_t, arena::string> G_groups;
+static std::map<PSID, std::pair<std::string_view, std::string_view>> G_owners;
+// Storage for the names in G_owners
+static std::deque<arena::string> S_owner_names;
 #endif
 
 
@@ -87,34 +84,21 @@ static def escape_nongraphic (char32_t c, arena::string &out)
 static def add_frills (const arena::string &str, arena::string &out)
 {
   let const always_quote = Arguments::quoting == QuoteMode::double_;
-  let need_quoting = false;
+  let const classes = quoting::classify (str);
   let quote_char = always_quote ? '"' : '\0';
-  let p = str.c_str ();
-  char32_t c;
-  int cp_size = 0;
-
-  out.reserve (str.size () * 1.2);
-
-  // Source: https://www.opencoverage.net/coreutils/index_html/source_213.html
-  // Quote the name if it starts with any of there
-  let constexpr quote_if_first = "#~"sv;
-  // Quote the name if it contains any of these
-  let constexpr quote_if_anywhere = " !$&()*;<=>[^`|"sv;
 
   if (Arguments::quoting != QuoteMode::literal)
     {
-      // Pre-process for quotation marks since we need to know ahead of time if we
-      // we'll need to escape them in the second loop. We do not need to care about
-      // unicode in this loop.
-      for (let const c : str)
-        {
-          if (c == '\'' && !quote_char) // Prefer single quotes if the name contains both styles
-            quote_char = '"';
-          else if (c == '"' && !always_quote)
-            quote_char = '\'';
-          else if (quote_if_anywhere.find (c) != std::string_view::npos)
-            need_quoting = true;
-        }
+      // Prefer single quotes if the name contains both styles
+      if ((classes & quoting::double_quote) && !always_quote)
+        quote_char = '\'';
+      else if ((classes & quoting::single_quote) && !quote_char)
+        quote_char = '"';
+
+      // Source: https://www.opencoverage.net/coreutils/index_html/source_213.html
+      // Quote the name if it starts with any of these
+      let constexpr quote_if_first = "#~"sv;
+      let need_quoting = (classes & quoting::special) != 0;
       if (!need_quoting && quote_if_first.find (str[0]) != std::string_view::npos)
         need_quoting = true;
       // These may be special if isolated (line 525 in the above mention source)
@@ -123,62 +107,73 @@ static def add_frills (const arena::string &str, arena::string &out)
 
       if (need_quoting && !quote_char)
         quote_char = '\'';
-
-      if (quote_char)
-        out.push_back (quote_char);
     }
 
-  let push_code_point = [&cp_size, &p, &out]() {
-    for (let i = 0; i < cp_size; ++i)
-      out.push_back (p[i]);
-  };
+  // Only ASCII bytes are ever escaped, so the bytes of multibyte characters
+  // (and of invalid UTF-8) are copied unchanged.
+  let const escape_quotes = (quote_char == '"' ? (classes & quoting::double_quote)
+                             : quote_char == '\'' ? (classes & quoting::single_quote)
+                             : 0);
+  let const escape_controls = ((classes & quoting::control)
+                               && Arguments::nongraphic != NongraphicMode::show);
 
-  for (std::size_t i = 0; i < str.size (); i += cp_size, p += cp_size)
-    {
-      c = unicode::utf8_to_codepoint (p, &cp_size);
+  out.reserve (str.size () + 2);
+  if (quote_char)
+    out.push_back (quote_char);
 
-      if (c == static_cast<char32_t> (quote_char))
-        {
-          out.push_back ('\\');
-          out.push_back (c);
-        }
-      else if (c < 0x80 && !std::isprint (c))
+  if (!escape_quotes && !escape_controls)
+    out.append (str);
+  else
+    {
+      for (let const c : str)
         {
-          switch (Arguments::nongraphic)
+          if (c == quote_char)
+            {
+              out.push_back ('\\');
+              out.push_back (c);
+            }
+          else if (escape_controls && quoting::byte_class (c) == quoting::control)
             {
-              case NongraphicMode::escape:
+              if (Arguments::nongraphic == NongraphicMode::escape)
                 escape_nongraphic (c, out);
-                break;
-              case NongraphicMode::hide:
+              else
                 out.push_back ('?');
-                break;
-              case NongraphicMode::show:
-                push_code_point ();
-                break;
             }
+          else
+            out.push_back (c);
         }
-      else
-        push_code_point ();
     }
 
-  if (Arguments::quoting != QuoteMode::literal && quote_char)
+  if (quote_char)
     out.push_back (quote_char);
 }
 
 
+// The last component of `path`
+static def file_name_of (std::string_view path) -> std::string_view
+{
+#ifdef _WIN32
+  let const sep = path.find_last_of ("\\/");
+#else
+  let const sep = path.rfind ('/');
+#endif
+  return sep == std::string_view::npos ? path : path.substr (sep + 1);
+}
+
+
 FileInfo::FileInfo (const fs::path &p, const fs::file_status &s, link_target_tag)
-  : _path (fs::absolute (p))
 {
   let const p_str = unicode::path_to_str (p);
   add_frills (p_str, name);
+  _path = p_str;
 
-  let const ext = p.extension ();
+  extension_kind = extension::lookup (extension::of (file_name ()));
 
-  if (ext == S_tmp_ext || ext == S_bak_ext || p_str.back () == '~')
+  if (extension_kind == extension::Kind::temporary || p_str.back () == '~')
     is_temporary = true;
 
 #ifdef _WIN32
-  if (ext == S_exe_ext || ext == S_bat_ext || ext == S_cmd_ext)
+  if (extension_kind == extension::Kind::executable)
     is_executable = true;
 #else
   if (s.type () == fs::file_type::regular)
@@ -192,7 +187,7 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &s, link_target_tag
 #endif
 
 #ifdef _WIN32
-  if (target || ext == S_lnk_ext)
+  if (extension_kind == extension::Kind::shortcut)
     type = fs::file_type::symlink;
   else
 #endif
@@ -200,25 +195,356 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &s, link_target_tag
 }
 
 
-FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
-  : _path (fs::absolute (p))
+static def resolve_link (const fs::path &p, const fs::path &real_tp) -> fs::path
+{
+  return (real_tp.is_absolute ()
+          ? real_tp
+          : fs::absolute (p.parent_path() / real_tp));
+}
+
+
+#ifndef _WIN32
+
+static def mode_to_status (mode_t mode) -> fs::file_status
+{
+  fs::file_type type;
+  switch (mode & S_IFMT)
+    {
+      case S_IFREG:  type = fs::file_type::regular; break;
+      case S_IFDIR:  type = fs::file_type::directory; break;
+      case S_IFLNK:  type = fs::file_type::symlink; break;
+      case S_IFBLK:  type = fs::file_type::block; break;
+      case S_IFCHR:  type = fs::file_type::character; break;
+      case S_IFIFO:  type = fs::file_type::fifo; break;
+      case S_IFSOCK: type = fs::file_type::socket; break;
+      default:       type = fs::file_type::unknown; break;
+    }
+  return fs::file_status (type, static_cast<fs::perms> (mode & 07777));
+}
+
+
+#ifndef HAVE_STATX
+// Without statx these only decide which fields we need at all
+enum : unsigned
+{
+  STATX_TYPE = 0x1,
+  STATX_MODE = 0x2,
+  STATX_NLINK = 0x4,
+  STATX_UID = 0x8,
+  STATX_GID = 0x10,
+  STATX_ATIME = 0x20,
+  STATX_MTIME = 0x40,
+  STATX_CTIME = 0x80,
+  STATX_INO = 0x100,
+  STATX_SIZE = 0x200,
+};
+#endif
+
+
+// The statx fields the FileInfo constructor needs for the current arguments.
+// STATX_TYPE is left out if the type is already known from readdir.
+static def needed_fields (bool type_known) -> unsigned
+{
+  let static const fields = []() {
+    let const &has = Arguments::long_columns_has;
+    let const long_listing = Arguments::long_listing;
+    let mask = 0u;
+    if (Arguments::color || Arguments::file_icons
+        || (Arguments::classify && !Arguments::file_type)
+        || (long_listing && (has.test (LongColumn::rwx_perms)
+                             || has.test (LongColumn::oct_perms))))
+      mask |= STATX_MODE;
+    if (long_listing && has.test (LongColumn::hard_link_count))
+      mask |= STATX_NLINK;
+    if (long_listing && has.test (LongColumn::owner_name))
+      mask |= STATX_UID;
+    if (long_listing && has.test (LongColumn::group_name))
+      mask |= STATX_GID;
+    if ((long_listing && has.test (LongColumn::size))
+        || Arguments::sort_mode == SortMode::size)
+      mask |= STATX_SIZE;
+    if ((long_listing && has.test (LongColumn::date))
+        || Arguments::sort_mode == SortMode::time)
+      {
+        switch (Arguments::time_mode)
+          {
+            case TimeMode::access: mask |= STATX_ATIME; break;
+            case TimeMode::write: mask |= STATX_MTIME; break;
+            case TimeMode::creation: mask |= STATX_CTIME; break;
+          }
+      }
+    // Needed to detect loops when we follow all symlinks
+    if (Arguments::recursive && Arguments::dereference)
+      mask |= STATX_INO;
+    return mask;
+  }();
+  // With --dereference the readdir type is the type of the link itself
+  return fields | (type_known && !Arguments::dereference ? 0 : STATX_TYPE);
+}
+
+// Fields needed to recurse into the target of a symlink
+static constexpr unsigned S_directory_fields = STATX_TYPE | STATX_INO;
+
+
+struct PrefetchedStat
+{
+#ifdef HAVE_IO_URING
+  struct statx stx;
+  // 0, the errno of the call or uring::not_run
+  int error;
+#endif
+};
+
+
+#ifdef HAVE_STATX
+static def from_statx (const struct statx &stx, struct stat *sb) -> void
+{
+  *sb = {};
+  sb->st_dev = makedev (stx.stx_dev_major, stx.stx_dev_minor);
+  sb->st_ino = stx.stx_ino;
+  sb->st_mode = stx.stx_mode;
+  sb->st_nlink = stx.stx_nlink;
+  sb->st_uid = stx.stx_uid;
+  sb->st_gid = stx.stx_gid;
+  sb->st_size = stx.stx_size;
+  sb->st_atim.tv_sec = stx.stx_atime.tv_sec;
+  sb->st_atim.tv_nsec = stx.stx_atime.tv_nsec;
+  sb->st_mtim.tv_sec = stx.stx_mtime.tv_sec;
+  sb->st_mtim.tv_nsec = stx.stx_mtime.tv_nsec;
+  sb->st_ctim.tv_sec = stx.stx_ctime.tv_sec;
+  sb->st_ctim.tv_nsec = stx.stx_ctime.tv_nsec;
+  if (!(stx.stx_mask & STATX_TYPE))
+    sb->st_mode &= ~S_IFMT;
+}
+#endif
+
+
+// Fills `sb` for a path relative to `dir_fd` and returns 0 or the errno of
+// the failed call.  With statx only the fields in `mask` are requested, the
+// others are left zeroed.  A completed `prefetched` call is used instead of
+// making a new one.
+static def stat_at (int dir_fd, const char *name, bool follow,
+                    [[maybe_unused]] unsigned mask, struct stat *sb,
+                    [[maybe_unused]] const PrefetchedStat *prefetched = nullptr) -> int
+{
+#ifdef HAVE_IO_URING
+  if (prefetched && prefetched->error != uring::not_run)
+    {
+      if (prefetched->error)
+        return prefetched->error;
+      from_statx (prefetched->stx, sb);
+      return 0;
+    }
+#endif
+  stats::add (stats::stat_calls);
+#ifdef HAVE_STATX
+  static std::atomic<bool> S_no_statx = false;
+  if (!S_no_statx.load (std::memory_order_relaxed))
+    {
+      struct statx stx;
+      if (statx (dir_fd, name, follow ? 0 : AT_SYMLINK_NOFOLLOW, mask, &stx) == 0)
+        {
+          from_statx (stx, sb);
+          return 0;
+        }
+      if (errno != ENOSYS)
+        return errno;
+      // Kernel too old or statx blocked by a seccomp filter
+      S_no_statx = true;
+    }
+#endif
+  return fstatat (dir_fd, name, sb, follow ? 0 : AT_SYMLINK_NOFOLLOW) == -1 ? errno : 0;
+}
+
+
+// Like fs::status or fs::symlink_status (depending on `follow`) for a path
+// relative to `dir_fd`.  If the type was not requested `known_type` is used.
+static def status_at (int dir_fd, const char *name, bool follow, unsigned mask,
+                      fs::file_type known_type, struct stat *sb,
+                      std::error_code &ec,
+                      const PrefetchedStat *prefetched = nullptr) -> fs::file_status
+{
+  if (let const err = stat_at (dir_fd, name, follow, mask, sb, prefetched); err)
+    {
+      ec = std::error_code (err, std::system_category ());
+      return fs::file_status (err == ENOENT || err == ENOTDIR
+                              ? fs::file_type::not_found
+                              : fs::file_type::none);
+    }
+  ec.clear ();
+  let s = mode_to_status (sb->st_mode);
+  if ((sb->st_mode & S_IFMT) == 0)
+    s.type (known_type);
+  return s;
+}
+
+
+static def read_link_at (int dir_fd, const char *name, std::error_code &ec) -> fs::path
+{
+  stats::add (stats::readlink_calls);
+  std::string buf (256, '\0');
+  for (;;)
+    {
+      let const n = readlinkat (dir_fd, name, buf.data (), buf.size ());
+      if (n == -1)
+        {
+          ec = std::error_code (errno, std::system_category ());
+          return {};
+        }
+      if (static_cast<std::size_t> (n) < buf.size ())
+        {
+          buf.resize (n);
+          ec.clear ();
+          return fs::path (std::move (buf));
+        }
+      buf.resize (buf.size () * 2);
+    }
+}
+
+
+// The fields of the first stat call FileStatus::init makes for an entry of
+// the readdir type `type`, or 0 if readdir already told us everything we need.
+static def first_stat_fields (fs::file_type type) -> unsigned
+{
+  let const type_known = type != fs::file_type::unknown;
+  let const fields = needed_fields (type_known);
+  // The permissions are only needed to check if regular files are executable
+  if (fields == STATX_MODE && type_known && type != fs::file_type::regular)
+    return 0;
+  return fields;
+}
+
+
+FileStatus::FileStatus (int dir_fd, const fs::path &dir, const char *name,
+                        fs::file_type type, const PrefetchedStat *prefetched)
+  : path (dir / name)
+  , in_directory (true)
+  , in_s (type)
+{
+  init (dir_fd, name, prefetched);
+}
+
+
+def FileStatus::init (int dir_fd, const char *name,
+                      const PrefetchedStat *prefetched) -> void
+{
+  let const type_known = in_s.type () != fs::file_type::unknown;
+  let const fields = first_stat_fields (in_s.type ());
+  if (fields == 0)
+    {
+      sb = {};
+      s = fs::file_status (in_s.type ());
+    }
+  else
+    s = status_at (dir_fd, name, Arguments::dereference, fields, in_s.type (),
+                   &sb, error, prefetched);
+  if (!Arguments::dereference)
+    in_s = s;
+  else if (!type_known)
+    {
+      struct stat link_sb;
+      std::error_code ec;
+      in_s = status_at (dir_fd, name, false, needed_fields (false), in_s.type (),
+                        &link_sb, ec);
+    }
+  if (error)
+    return;
+
+  std::error_code ec;
+  if (Arguments::long_listing && s.type () == fs::file_type::symlink)
+    {
+      link_target = read_link_at (dir_fd, name, ec);
+      if (!ec)
+        {
+          // A relative target is relative to the directory of the link, which
+          // is `dir_fd` unless we were given a path.
+          let const tp = (dir_fd == AT_FDCWD
+                          ? resolve_link (path, link_target)
+                          : link_target);
+          struct stat target_sb;
+          link_target_s = status_at (dir_fd, tp.c_str (), Arguments::dereference,
+                                     needed_fields (false), fs::file_type::unknown,
+                                     &target_sb, ec);
+        }
+    }
+
+  // Only the file name of the target is used so there is no need to resolve
+  // it.
+  if (Arguments::dereference && in_s.type () == fs::file_type::symlink)
+    deref_target = read_link_at (dir_fd, name, ec);
+}
+
+
+FileStatus::FileStatus (const fs::path &dir, const cache::Entry &e)
+  : path (dir / e.name)
+  , in_directory (true)
+  , in_s (e.in_type, e.in_perms)
+  , s (e.type, e.perms)
+  , sb (e.sb)
+  , link_target (e.link_target)
+  , link_target_s (e.link_target_type, e.link_target_perms)
+  , deref_target (e.deref_target)
+{
+  if (e.error)
+    error = std::error_code (e.error, std::system_category ());
+}
+
+#endif // !_WIN32
+
+
+FileStatus::FileStatus (const fs::path &p, const fs::file_status &in_s)
+  : path (p)
+  , in_s (in_s)
 {
-  let const status = [](const fs::path &p) {
-    return Arguments::dereference ? fs::status (p, S_ec) : fs::symlink_status (p, S_ec);
+#ifdef _WIN32
+  let const status = [](const fs::path &p, std::error_code &ec) {
+    stats::add (stats::stat_calls);
+    return Arguments::dereference ? fs::status (p, ec) : fs::symlink_status (p, ec);
   };
-  let const s = status (p);
+  s = status (p, error);
+  if (error)
+    return;
+
+  std::error_code ec;
+  if (Arguments::long_listing && s.type () == fs::file_type::symlink)
+    {
+      stats::add (stats::readlink_calls);
+      link_target = fs::read_symlink (p, ec);
+      if (!ec)
+        link_target_s = status (resolve_link (p, link_target), ec);
+    }
+
+  if (Arguments::dereference && in_s.type () == fs::file_type::symlink)
+    {
+      stats::add (stats::readlink_calls);
+      deref_target = fs::read_symlink (p, ec);
+    }
+#else
+  init (AT_FDCWD, p.c_str (), nullptr);
+#endif
+}
+
+
+FileInfo::FileInfo (const FileStatus &st)
+{
+  let const &p = st.path;
+  let const &s = st.s;
+  let p_str = unicode::path_to_str (p.filename ());
+  _path = st.in_directory ? p_str : unicode::path_to_str (fs::absolute (p));
+
   S_did_complain = false;
-  if (S_ec)
+  if (st.error)
     {
+      S_ec = st.error;
       complain (p);
-      add_frills (unicode::path_to_str (p.filename ()), name);
+      add_frills (p_str, name);
       status_failed = true;
       return;
     }
 
-  let p_str = unicode::path_to_str (p.filename ());
   add_frills (p_str, name);
-  let ext = p.extension ();
+  extension_kind = extension::lookup (extension::of (p_str));
+  let ext_kind = extension_kind;
 
 #ifdef _WIN32
   HANDLE handle;
@@ -241,23 +567,17 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
       return;
     }
 #else
-  static struct stat sb;
-  if ((Arguments::dereference ? stat : lstat)
-      (fs::absolute (p).string<char> (arena::Allocator<char> {}).c_str (), &sb) == -1)
-    {
-      S_ec = std::error_code (errno, std::system_category ());
-      complain (p);
-      status_failed = true;
-      return;
-    }
   // Alias so we can just use handle and file_info
+  struct stat sb = st.sb;
   struct stat *const handle = &sb;
   struct stat &file_info = sb;
 #endif
 
   if (Arguments::long_listing)
     {
-      if (!get_owner_and_group (handle, owner, group))
+      if ((Arguments::long_columns_has.test (LongColumn::owner_name)
+           || Arguments::long_columns_has.test (LongColumn::group_name))
+          && !get_owner_and_group (handle, owner, group))
         {
 #ifdef _WIN32
           S_ec = std::error_code (GetLastError (), std::system_category ());
@@ -283,24 +603,6 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
       link_count = get_link_count (&file_info);
 
       perms = s.permissions ();
-
-      if (s.type () == fs::file_type::symlink)
-        {
-          let const real_tp = fs::read_symlink (p);
-          let const tp = (real_tp.is_absolute ()
-                          ? real_tp
-                          : fs::absolute (p.parent_path() / real_tp));
-          target = new FileInfo (real_tp, status (tp), link_target_tag {});
-        }
-#ifdef _WIN32
-      else if (G_has_shortcut_interfaces && ext == S_lnk_ext)
-        {
-          arena::string target_name;
-          get_shortcut_target (p, target_name);
-          let const tp = fs::path (target_name);
-          target = new FileInfo (tp, status (tp), link_target_tag {});
-        }
-#endif
     }
   else
     {
@@ -319,21 +621,17 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
     }
 
   // Get the correct name for name dependant file types
-  if (Arguments::dereference && in_s.type () == fs::file_type::symlink)
+  if (!st.deref_target.empty ())
     {
-      let const real_tp = fs::read_symlink (p);
-      let const tp = (real_tp.is_absolute ()
-                      ? real_tp
-                      : fs::absolute (p.parent_path() / real_tp));
-      ext = tp.extension ();
-      p_str = unicode::path_to_str (tp);
+      p_str = unicode::path_to_str (st.deref_target);
+      ext_kind = extension::lookup (extension::of (file_name_of (p_str)));
     }
 
-  if (ext == S_tmp_ext || ext == S_bak_ext || p_str.back () == '~')
+  if (ext_kind == extension::Kind::temporary || p_str.back () == '~')
     is_temporary = true;
 
 #ifdef _WIN32
-  if (ext == S_exe_ext || ext == S_bat_ext || ext == S_cmd_ext)
+  if (ext_kind == extension::Kind::executable)
     is_executable = true;
 #else
   if (s.type () == fs::file_type::regular)
@@ -347,7 +645,7 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
 #endif
 
 #ifdef _WIN32
-  if (target || ext == S_lnk_ext)
+  if (ext_kind == extension::Kind::shortcut)
     type = fs::file_type::symlink;
   else
 #endif
@@ -355,9 +653,52 @@ FileInfo::FileInfo (const fs::path &p, const fs::file_status &in_s)
 }
 
 
-FileInfo::~FileInfo ()
+def FileInfo::file_name () const -> std::string_view
 {
-  delete target;
+  return file_name_of (_path);
+}
+
+
+def FileList::add (const FileStatus &st) -> const FileInfo &
+{
+  stats::Timer timer (stats::metadata);
+  stats::add (stats::entries);
+  M_order.push_back (static_cast<std::uint32_t> (M_files.size ()));
+  let &f = M_files.emplace_back (st);
+  if (st.in_directory)
+    f._directory = &directory;
+
+  if (!Arguments::long_listing || f.status_failed)
+    return f;
+
+  if (st.s.type () == fs::file_type::symlink && !st.link_target.empty ())
+    {
+      let &t = M_targets.emplace_back (st.link_target, st.link_target_s,
+                                       FileInfo::link_target_tag {});
+      // Relative targets are relative to the directory of the link
+      if (st.link_target.is_relative ())
+        {
+          if (st.in_directory)
+            t._directory = &directory;
+          else
+            t._path = unicode::path_to_str (resolve_link (st.path, st.link_target));
+        }
+      f.target = &t;
+    }
+#ifdef _WIN32
+  else if (G_has_shortcut_interfaces
+           && f.extension_kind == extension::Kind::shortcut)
+    {
+      arena::string target_name;
+      get_shortcut_target (st.path, target_name);
+      let const tp = fs::path (target_name);
+      f.target = &M_targets.emplace_back (tp, (Arguments::dereference
+                                               ? fs::status (tp, S_ec)
+                                               : fs::symlink_status (tp, S_ec)),
+                                          FileInfo::link_target_tag {});
+    }
+#endif
+  return f;
 }
 
 
@@ -387,48 +728,664 @@ def can_list (const fs::path &path) -> bool
 
 def list_file (const fs::path &path) -> void
 {
-  G_singles.emplace_back (path, fs::symlink_status (path));
+  G_singles.add (FileStatus (path, fs::symlink_status (path)));
 }
 
 
-def list_dir (const fs::path &path) -> void
+static def is_ignored (std::string_view name) -> bool
 {
-  let dir_it = fs::directory_iterator(path, S_ec);
-  if (S_ec)
+  if (!Arguments::all && name[0] == '.')
+    return true;
+  if (Arguments::ignore_backups
+      && (name.ends_with (".tmp"sv)
+          || name.ends_with (".bak"sv)
+          || name.back () == '~'))
+    return true;
+  return Arguments::ignore_patterns.matches (name);
+}
+
+
+// A directory of a listing.  Scanning it fills `entries` and creates a node
+// for every subdirectory that gets listed, so the nodes can be emitted in the
+// same order as a sequential depth-first traversal no matter which thread
+// scanned them.  Scanning may happen on a worker thread so this only uses the
+// standard allocator.
+struct DirNode
+{
+  DirNode (const fs::path &p, const fs::path &abs_p, const DirNode *parent)
+    : path (p)
+    , abs_path (abs_p)
+    , parent (parent)
+  {}
+
+  fs::path path;
+  fs::path abs_path;
+  const DirNode *parent;
+#ifndef _WIN32
+  // Identity of the directory, to avoid running in circles through symlinks
+  dev_t dev {0};
+  ino_t ino {0};
+#endif
+  std::error_code error {};
+  std::vector<FileStatus> entries {};
+  // Subdirectories, with the index of their entry in `entries`
+  std::vector<std::pair<std::size_t, std::unique_ptr<DirNode>>> children {};
+  bool done { false };
+};
+
+static std::unique_ptr<ThreadPool> S_pool;
+static std::mutex S_done_mutex;
+static std::condition_variable S_done;
+
+static def scan_dir (DirNode &node) -> void;
+
+
+static def add_child (DirNode &node, bool is_loop) -> void
+{
+  let const &st = node.entries.back ();
+  let &child = node.children.emplace_back (
+    node.entries.size () - 1,
+    std::make_unique<DirNode> (st.path, node.abs_path / st.path.filename (), &node)
+  ).second;
+  if (is_loop)
     {
-      complain(path);
-      return;
+      child->error = std::make_error_code (std::errc::too_many_symbolic_link_levels);
+      child->done = true;
     }
+  else if (S_pool)
+    S_pool->submit ([c = child.get ()]() { scan_dir (*c); });
+}
 
-  std::error_code ec;
-  FileList *l = &G_directories.emplace_back (std::make_pair (path, FileList {})).second;
-  fs::path canonical;
 
-  for (let e : dir_it)
+#ifdef _WIN32
+
+static def scan_dir (DirNode &node) -> void
+{
+  stats::Timer timer (stats::enumerate);
+  stats::add (stats::directories);
+  std::error_code ec, it_ec;
+  fs::directory_iterator dir_it (node.path, node.error);
+  for (; !node.error && !it_ec && dir_it != fs::directory_iterator ();
+       dir_it.increment (it_ec))
     {
-      let const pstr = unicode::path_to_str (e.path ().filename ());
-      if (!Arguments::all && pstr[0] == '.')
+      let const &e = *dir_it;
+      let const name = e.path ().filename ().u8string ();
+      if (is_ignored ({reinterpret_cast<const char *> (name.data ()), name.size ()}))
         continue;
-      if (Arguments::ignore_backups
-          && (pstr.ends_with (".tmp"sv)
-              || pstr.ends_with (".bak"sv)
-              || pstr.back () == '~'))
+
+      // This error code is ignored since we do another call to the correct
+      // status function inside the FileStatus constructor and check the error
+      // code of that.
+      node.entries.emplace_back (e.path (), e.symlink_status (ec));
+
+      if (Arguments::recursive && e.is_directory (ec))
+        add_child (node, false);
+    }
+
+#else // _WIN32
+
+static def dirent_type (unsigned char d_type) -> fs::file_type
+{
+  switch (d_type)
+    {
+      case DT_REG:  return fs::file_type::regular;
+      case DT_DIR:  return fs::file_type::directory;
+      case DT_LNK:  return fs::file_type::symlink;
+      case DT_BLK:  return fs::file_type::block;
+      case DT_CHR:  return fs::file_type::character;
+      case DT_FIFO: return fs::file_type::fifo;
+      case DT_SOCK: return fs::file_type::socket;
+      default:      return fs::file_type::unknown;
+    }
+}
+
+
+// Reads the entries of an open directory.  On Linux this calls getdents64
+// directly with a large buffer, so even huge directories only cost one system
+// call per buffer and the entry type comes for free.
+class DirReader
+{
+public:
+  DirReader (int fd)
+    : M_fd (fd)
+#ifndef __linux__
+    , M_dir (fdopendir (fd))
+#endif
+  {}
+
+  ~DirReader ()
+  {
+#ifdef __linux__
+    close (M_fd);
+#else
+    if (M_dir)
+      closedir (M_dir);
+    else
+      close (M_fd);
+#endif
+  }
+
+  // Returns the name of the next entry and sets `type` to its d_type, or
+  // returns nullptr at the end of the directory or on error.
+  def next (unsigned char &type) -> const char *
+  {
+#ifdef __linux__
+    if (M_pos == M_size)
+      {
+        let const n = syscall (SYS_getdents64, M_fd, S_buf.get (), S_buf_size);
+        if (n <= 0)
+          return nullptr;
+        M_pos = 0;
+        M_size = static_cast<std::size_t> (n);
+      }
+    let const e = reinterpret_cast<const struct dirent64 *> (S_buf.get () + M_pos);
+    M_pos += e->d_reclen;
+    type = e->d_type;
+    return e->d_name;
+#else
+    if (!M_dir)
+      return nullptr;
+    let const e = readdir (M_dir);
+    if (!e)
+      return nullptr;
+    type = e->d_type;
+    return e->d_name;
+#endif
+  }
+
+private:
+  int M_fd;
+#ifdef __linux__
+  static constexpr std::size_t S_buf_size = 256 * 1024;
+  static thread_local inline std::unique_ptr<char[]> S_buf {new char[S_buf_size]};
+  std::size_t M_pos {0};
+  std::size_t M_size {0};
+#else
+  DIR *M_dir;
+#endif
+};
+
+
+// Entries read from a directory before their FileStatuses are created
+static constexpr std::size_t S_scan_chunk_size = 4096;
+
+// An entry read from a directory, its name is at offset `name` of the chunk's
+// name buffer.
+struct Found
+{
+  std::size_t name;
+  fs::file_type type;
+  // Only read to be stored in the cache
+  bool ignored;
+};
+
+
+// Stats the entries of a chunk through io_uring, with the same fields the
+// FileStatus constructor would ask for.  Returns false if the FileStatuses
+// should make the calls themselves.
+static def prefetch_stats ([[maybe_unused]] int fd,
+                           [[maybe_unused]] const std::string &names,
+                           [[maybe_unused]] const std::vector<Found> &found,
+                           [[maybe_unused]] std::vector<PrefetchedStat> &prefetched) -> bool
+{
+#ifdef HAVE_IO_URING
+  // Below this the ring is not worth the extra bookkeeping
+  constexpr std::size_t min_batch = 8;
+  if (found.size () < min_batch)
+    return false;
+  stats::Timer timer (stats::metadata);
+
+  prefetched.resize (found.size ());
+  std::vector<uring::StatxRequest> requests;
+  std::vector<std::size_t> indices;
+  requests.reserve (found.size ());
+  indices.reserve (found.size ());
+  for (std::size_t i = 0; i < found.size (); ++i)
+    {
+      prefetched[i].error = uring::not_run;
+      let const fields = first_stat_fields (found[i].type);
+      if (fields == 0)
         continue;
-      for (let pattern : Arguments::ignore_patterns)
+      requests.push_back ({
+        fd, names.data () + found[i].name,
+        Arguments::dereference ? 0 : AT_SYMLINK_NOFOLLOW, fields,
+        &prefetched[i].stx, uring::not_run
+      });
+      indices.push_back (i);
+    }
+  if (requests.size () < min_batch || !uring::statx_all (requests))
+    return false;
+
+  std::size_t completed = 0;
+  for (std::size_t j = 0; j < requests.size (); ++j)
+    {
+      prefetched[indices[j]].error = requests[j].error;
+      completed += requests[j].error != uring::not_run;
+    }
+  stats::add (stats::stat_calls, completed);
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+// Whether -R descends into an entry.  For symlinks `dev` and `ino` identify
+// the directory they point to, for the loop check.
+struct Descent
+{
+  bool is_directory { false };
+  dev_t dev {0};
+  ino_t ino {0};
+};
+
+
+static def descent_of (int fd, const char *name, const FileStatus &st) -> Descent
+{
+  if (!Arguments::recursive || st.error)
+    return {};
+  // Symlinks to directories get listed as well so we need to look at
+  // the target if we did not already follow it.
+  if (st.in_s.type () == fs::file_type::symlink && !Arguments::dereference)
+    {
+      struct stat sb;
+      if (stat_at (fd, name, true, S_directory_fields, &sb) != 0
+          || !S_ISDIR (sb.st_mode))
+        return {};
+      return { true, sb.st_dev, sb.st_ino };
+    }
+  return { st.s.type () == fs::file_type::directory, st.sb.st_dev, st.sb.st_ino };
+}
+
+
+// Creates the node of the last entry of `node` if it gets descended into
+static def descend (DirNode &node, const Descent &d) -> void
+{
+  if (!d.is_directory)
+    return;
+  let const is_link = node.entries.back ().in_s.type () == fs::file_type::symlink;
+  let loop = false;
+  for (const DirNode *n = &node; is_link && n && !loop; n = n->parent)
+    loop = n->dev == d.dev && n->ino == d.ino;
+  add_child (node, loop);
+}
+
+
+// Value that tells apart cache files written for arguments that need
+// different information about the entries
+static def cache_signature () -> std::uint64_t
+{
+  return (std::uint64_t (needed_fields (false))
+          | std::uint64_t (Arguments::dereference) << 32
+          | std::uint64_t (Arguments::recursive) << 33
+          | std::uint64_t (Arguments::long_listing) << 34);
+}
+
+
+static def to_cache_entry (const FileStatus &st, const Descent &d) -> cache::Entry
+{
+  let const path = std::string_view (st.path.native ());
+  return {
+    .name = path.substr (path.rfind ('/') + 1),
+    .in_type = st.in_s.type (),
+    .in_perms = st.in_s.permissions (),
+    .type = st.s.type (),
+    .perms = st.s.permissions (),
+    .error = st.error.value (),
+    .sb = st.sb,
+    .link_target = st.link_target.native (),
+    .link_target_type = st.link_target_s.type (),
+    .link_target_perms = st.link_target_s.permissions (),
+    .deref_target = st.deref_target.native (),
+    .is_directory = d.is_directory,
+    .dev = d.dev,
+    .ino = d.ino,
+  };
+}
+
+
+// With `restat_dirs` the status of subdirectories is read again, since
+// their link count and times change without an event in the directory that
+// would drop what the server kept.
+static def add_cached (DirNode &node, const struct stat &dir_sb,
+                       const cache::Listing &listing, bool restat_dirs) -> void
+{
+  stats::add (stats::cached_directories);
+  node.dev = dir_sb.st_dev;
+  node.ino = dir_sb.st_ino;
+  restat_dirs = restat_dirs && first_stat_fields (fs::file_type::directory) != 0;
+  let dir_fd = -1;
+  for (std::size_t i = 0; i < listing.size (); ++i)
+    {
+      let const e = listing[i];
+      if (is_ignored (e.name))
+        continue;
+      if (restat_dirs && e.type == fs::file_type::directory && dir_fd == -1)
+        dir_fd = open (node.path.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      if (restat_dirs && e.type == fs::file_type::directory && dir_fd != -1)
+        node.entries.emplace_back (dir_fd, node.path, std::string (e.name).c_str (),
+                                   e.in_type);
+      else
+        node.entries.emplace_back (node.path, e);
+      descend (node, { e.is_directory, e.dev, e.ino });
+    }
+  if (dir_fd != -1)
+    close (dir_fd);
+}
+
+
+// Fills `node` from what the server kept or from the cache if either has the
+// directory and it did not change since.  This costs a single stat call,
+// and one for each subdirectory in what the server kept.
+static def scan_cached (DirNode &node) -> bool
+{
+  struct stat dir_sb;
+  stats::add (stats::stat_calls);
+  if (stat (node.path.c_str (), &dir_sb) != 0)
+    return false;
+  let const signature = cache_signature ();
+#ifdef __linux__
+  if (server::in_request ())
+    {
+      let const data = server::find (cache::identity (dir_sb, signature));
+      if (cache::Listing listing (data, dir_sb, signature); listing)
         {
-          if (match (pattern, pstr))
-            goto skip_file;
+          add_cached (node, dir_sb, listing, true);
+          return true;
         }
+    }
+#endif
+  if (!Arguments::cache_dir)
+    return false;
+  cache::Listing listing (dir_sb, signature);
+  if (!listing)
+    return false;
+  add_cached (node, dir_sb, listing, false);
+  return true;
+}
 
-      // This error code is ignored since we do another call to the correct
-      // status function inside the FileInfo constructor and check the error
-      // code of that.
-      l->emplace_back (e.path (), e.symlink_status (ec));
 
-      if (Arguments::recursive && e.is_directory ())
-        list_dir (e.path ());
-skip_file:;
+static def read_dir (DirNode &node) -> void
+{
+  // Watched before it is read, so the server sees every change that may not
+  // be in what we read
+  let wd = -1;
+#ifdef __linux__
+  if (server::in_request ())
+    wd = server::watch (node.abs_path);
+#endif
+  std::string data;
+  // The directory stays open while its entries are examined so they can be
+  // looked up relative to it instead of resolving their full path each time.
+  let const fd = open (node.path.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
+    node.error = std::error_code (errno, std::system_category ());
+  else
+    {
+      struct stat dir_sb;
+      stats::add (stats::stat_calls);
+      let const have_dir_sb = fstat (fd, &dir_sb) == 0;
+      if (have_dir_sb)
+        {
+          node.dev = dir_sb.st_dev;
+          node.ino = dir_sb.st_ino;
+        }
+
+      // The cache has all entries so it can be used with other --all and
+      // --ignore options; the ones not listed now are kept here.
+      let const store = (Arguments::cache_dir || wd != -1) && have_dir_sb;
+      std::vector<Descent> descents;
+      std::vector<std::pair<FileStatus, Descent>> ignored;
+
+      DirReader dir (fd);
+      // Names are read in chunks so the stat calls of a whole chunk can be
+      // submitted at once.
+      std::string names;
+      std::vector<Found> found;
+      std::vector<PrefetchedStat> prefetched;
+      unsigned char d_type;
+      let more = true;
+      while (more)
+        {
+          names.clear ();
+          found.clear ();
+          while (found.size () < S_scan_chunk_size)
+            {
+              let const d_name = dir.next (d_type);
+              if (!d_name)
+                {
+                  more = false;
+                  break;
+                }
+              let const name = std::string_view (d_name);
+              if (name == "."sv || name == ".."sv)
+                continue;
+              let const is_ignored_name = is_ignored (name);
+              if (is_ignored_name && !store)
+                continue;
+              found.push_back ({ names.size (), dirent_type (d_type), is_ignored_name });
+              names.append (name);
+              names.push_back ('\0');
+            }
+
+          let const have_prefetched = prefetch_stats (fd, names, found, prefetched);
+          for (std::size_t i = 0; i < found.size (); ++i)
+            {
+              let const name = names.data () + found[i].name;
+              let const pre = have_prefetched ? &prefetched[i] : nullptr;
+              if (found[i].ignored)
+                {
+                  let &[st, d] = ignored.emplace_back (
+                    FileStatus (fd, node.path, name, found[i].type, pre),
+                    Descent {}
+                  );
+                  d = descent_of (fd, name, st);
+                  continue;
+                }
+              let const &st = node.entries.emplace_back (fd, node.path, name,
+                                                          found[i].type, pre);
+              let const d = descent_of (fd, name, st);
+              descend (node, d);
+              if (store)
+                descents.push_back (d);
+            }
+        }
+
+      if (store)
+        {
+          std::vector<cache::Entry> entries;
+          entries.reserve (node.entries.size () + ignored.size ());
+          for (std::size_t i = 0; i < node.entries.size (); ++i)
+            entries.push_back (to_cache_entry (node.entries[i], descents[i]));
+          for (let const &[st, d] : ignored)
+            entries.push_back (to_cache_entry (st, d));
+          let const signature = cache_signature ();
+          data = cache::serialize (dir_sb, signature, entries);
+          if (Arguments::cache_dir)
+            cache::store (dir_sb, signature, data);
+        }
     }
+#ifdef __linux__
+  server::report (wd, data);
+#endif
+}
+
+
+static def scan_dir (DirNode &node) -> void
+{
+  stats::Timer timer (stats::enumerate);
+  stats::add (stats::directories);
+  if (!((Arguments::cache_dir || server::in_request ()) && scan_cached (node)))
+    read_dir (node);
+
+#endif // _WIN32
+
+  if (S_pool)
+    {
+      {
+        std::lock_guard lock (S_done_mutex);
+        node.done = true;
+      }
+      S_done.notify_all ();
+    }
+  else
+    node.done = true;
+}
+
+
+#ifndef _WIN32
+// Looks up the owners and groups of a directory's entries in one go before
+// the FileInfos ask for them one by one.
+static def resolve_owners (const std::vector<FileStatus> &entries) -> void
+{
+  if (!Arguments::long_listing
+      || !(Arguments::long_columns_has.test (LongColumn::owner_name)
+           || Arguments::long_columns_has.test (LongColumn::group_name)))
+    return;
+  stats::Timer timer (stats::owners);
+  arena::vector<uid_t> uids;
+  arena::vector<gid_t> gids;
+  uids.reserve (entries.size ());
+  gids.reserve (entries.size ());
+  for (let const &st : entries)
+    {
+      if (st.error)
+        continue;
+      uids.push_back (st.sb.st_uid);
+      gids.push_back (st.sb.st_gid);
+    }
+  owners::resolve (uids, gids);
+}
+#endif
+
+
+static def emit_dir (DirNode &node) -> void
+{
+  if (S_pool)
+    {
+      std::unique_lock lock (S_done_mutex);
+      S_done.wait (lock, [&node]() { return node.done; });
+    }
+  else if (!node.done)
+    scan_dir (node);
+
+  if (node.error)
+    {
+      S_ec = node.error;
+      complain (node.path);
+      return;
+    }
+
+  FileList *l = &G_directories.emplace_back (std::piecewise_construct,
+                                             std::forward_as_tuple (node.path),
+                                             std::forward_as_tuple (node.abs_path)
+                                             ).second;
+#ifndef _WIN32
+  resolve_owners (node.entries);
+#endif
+  let child = node.children.begin ();
+
+  for (std::size_t i = 0; i < node.entries.size (); ++i)
+    {
+      l->add (node.entries[i]);
+
+      if (child != node.children.end () && child->first == i)
+        {
+          emit_dir (*child->second);
+          child->second.reset ();
+          ++child;
+        }
+    }
+}
+
+
+def list_dir (const fs::path &path) -> void
+{
+  if (!S_pool && Arguments::recursive && Arguments::threads > 1)
+    S_pool = std::make_unique<ThreadPool> (Arguments::threads);
+
+  DirNode root (path, fs::absolute (path), nullptr);
+  if (S_pool)
+    S_pool->submit ([&root]() { scan_dir (root); });
+  emit_dir (root);
+}
+
+
+def can_stream () -> bool
+{
+  return (Arguments::sort_mode == SortMode::none
+          && Arguments::single_column
+          && !Arguments::long_listing
+          && !Arguments::recursive
+          // Streaming reads the directory itself
+          && !Arguments::cache_dir
+          && !server::in_request ()
+          // --watch keeps the listing
+          && !Arguments::watch);
+}
+
+
+static def print_lines (const FileList &files, bool has_quoted) -> void;
+
+
+def stream_dir (const fs::path &path, const std::function<void ()> &before) -> void
+{
+  // Entries per printed batch; the batch is reused so memory use does not
+  // depend on the size of the directory.
+  let constexpr batch_size = 1024;
+  stats::Timer timer (stats::enumerate);
+  stats::add (stats::directories);
+  FileList batch (fs::absolute (path));
+
+  let const flush = [&batch]() {
+    // Names are not shifted to line up with quoted ones as that would need
+    // to see all names first.
+    print_lines (batch, false);
+    G_out.flush ();
+    batch.clear ();
+  };
+
+#ifdef _WIN32
+  std::error_code ec, it_ec;
+  fs::directory_iterator dir_it (path, S_ec);
+  if (S_ec)
+    {
+      complain (path);
+      return;
+    }
+  before ();
+  for (; !it_ec && dir_it != fs::directory_iterator (); dir_it.increment (it_ec))
+    {
+      let const &e = *dir_it;
+      let const name = e.path ().filename ().u8string ();
+      if (is_ignored ({reinterpret_cast<const char *> (name.data ()), name.size ()}))
+        continue;
+      batch.add (FileStatus (e.path (), e.symlink_status (ec)));
+      if (batch.size () == batch_size)
+        flush ();
+    }
+#else
+  let const fd = open (path.c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd == -1)
+    {
+      S_ec = std::error_code (errno, std::system_category ());
+      complain (path);
+      return;
+    }
+  before ();
+  DirReader dir (fd);
+  unsigned char d_type;
+  while (let const d_name = dir.next (d_type))
+    {
+      let const name = std::string_view (d_name);
+      if (name == "."sv || name == ".."sv || is_ignored (name))
+        continue;
+      batch.add (FileStatus (fd, path, d_name, dirent_type (d_type)));
+      if (batch.size () == batch_size)
+        flush ();
+    }
+#endif
+  flush ();
 }
 
 #ifdef _WIN32
@@ -437,8 +1394,8 @@ IShellLink *G_sl = nullptr;
 IPersistFile *G_pf = nullptr;
 bool G_has_shortcut_interfaces = true;
 
-def get_owner_and_group (HANDLE file_handle, arena::string &owner_out,
-                         arena::string &group_out) -> bool
+def get_owner_and_group (HANDLE file_handle, std::string_view &owner_out,
+                         std::string_view &group_out) -> bool
 {
   PSID owner_sid;
   PSECURITY_DESCRIPTOR sd;
@@ -449,41 +1406,46 @@ def get_owner_and_group (HANDLE file_handle, arena::string &owner_out,
                        &owner_sid, NULL, NULL, NULL, &sd)
       != ERROR_SUCCESS)
     {
-      owner_out.assign ("?");
-      group_out.assign ("?");
+      owner_out = "?"sv;
+      group_out = "?"sv;
       return false;
     }
 
-  if (G_users.contains (owner_sid))
+  if (let const it = G_owners.find (owner_sid); it != G_owners.end ())
     {
-      owner_out.assign (G_users[owner_sid]);
-      group_out.assign (G_groups[owner_sid]);
+      stats::add (stats::owner_cache_hits);
+      owner_out = it->second.first;
+      group_out = it->second.second;
     }
   else
     {
+      stats::add (stats::nss_lookups);
       // first call for buffer sizes
       if (!LookupAccountSidA (NULL, owner_sid, NULL, (LPDWORD)&owner_size,
                               NULL, (LPDWORD)&group_size, &use)
           && GetLastError () != ERROR_INSUFFICIENT_BUFFER)
         {
-          owner_out.assign ("?");
-          group_out.assign ("?");
+          owner_out = "?"sv;
+          group_out = "?"sv;
           return false;
         }
 
-      owner_out.resize (owner_size);
-      group_out.resize (group_size);
+      arena::string owner (owner_size, '\0');
+      arena::string group (group_size, '\0');
 
-      if (!LookupAccountSidA (NULL, owner_sid, owner_out.data (), &owner_size,
-                              group_out.data (), &group_size, &use))
+      if (!LookupAccountSidA (NULL, owner_sid, owner.data (), &owner_size,
+                              group.data (), &group_size, &use))
         {
-          owner_out.assign ("?");
-          group_out.assign ("?");
+          owner_out = "?"sv;
+          group_out = "?"sv;
           return false;
         }
+      owner.resize (owner_size);
+      group.resize (group_size);
 
-      G_users[owner_sid] = owner_out;
-      G_groups[owner_sid] = group_out;
+      owner_out = S_owner_names.emplace_back (std::move (owner));
+      group_out = S_owner_names.emplace_back (std::move (group));
+      G_owners.emplace (owner_sid, std::make_pair (owner_out, group_out));
     }
 
   return true;
@@ -554,16 +1516,11 @@ def get_link_count (BY_HANDLE_FILE_INFORMATION *file_info) -> unsigned
 
 #else // _WIN32
 
-def get_owner_and_group (struct stat *sb, arena::string &owner_out,
-                         arena::string &group_out) -> bool
+def get_owner_and_group (struct stat *sb, std::string_view &owner_out,
+                         std::string_view &group_out) -> bool
 {
-  if (!G_users.contains (sb->st_uid))
-    G_users[sb->st_uid] = arena::string (getpwuid (sb->st_uid)->pw_name);
-  owner_out.assign (G_users[sb->st_uid]);
-
-  if (!G_groups.contains (sb->st_gid))
-    G_groups[sb->st_gid] = arena::string (getgrgid (sb->st_gid)->gr_name);
-  group_out.assign (G_groups[sb->st_gid]);
+  owner_out = owners::user_name (sb->st_uid);
+  group_out = owners::group_name (sb->st_gid);
   return true;
 }
 
@@ -604,107 +1561,326 @@ def file_time_to_time_t (fs::file_time_type ft) -> std::time_t
 }
 
 
-static int
-case_insensitive_compare (const fs::path &a, const fs::path &b)
+// A byte of a name as it is sorted.  Without --case-sensitive ASCII letters
+// are lowered and the high bit is flipped so that a plain comparison orders
+// the bytes as signed chars, like comparing the native path strings did.
+static inline def collate (char c) -> char
+{
+  if (Arguments::case_sensitive)
+    return c;
+  return static_cast<char> ((static_cast<unsigned char> (c) < 0x80
+                             ? std::tolower (c)
+                             : c)
+                            ^ 0x80);
+}
+
+
+// Sort keys for the files of a FileList, computed once before sorting so the
+// comparisons do not need to allocate or decode anything.
+struct SortKeys
+{
+  SortKeys (const arena::vector<FileInfo> &files)
+  {
+    let const n = files.size ();
+    if (Arguments::sort_mode == SortMode::version)
+      {
+        version.reserve (n);
+        for (let const &f : files)
+          {
+            let const begin = segments.size ();
+            natural_split (f.file_name (), segments);
+            version.emplace_back (begin, segments.size () - begin);
+          }
+        return;
+      }
+
+    // All other modes fall back to comparing the collated names, which are
+    // stored back to back.
+    let total = std::size_t (0);
+    for (let const &f : files)
+      total += f._path.size ();
+    names.resize (total);
+    name.reserve (n);
+    let out = names.data ();
+    for (let const &f : files)
+      {
+        let const begin = out;
+        for (let const c : f._path)
+          *out++ = collate (c);
+        name.emplace_back (begin, out - begin);
+      }
+
+    if (Arguments::sort_mode == SortMode::extension)
+      {
+        extension.reserve (n);
+        for (std::size_t i = 0; i < n; ++i)
+          {
+            let const len = extension::of (files[i].file_name ()).size ();
+            extension.push_back (name[i].substr (name[i].size () - len));
+          }
+      }
+    else if (Arguments::sort_mode == SortMode::width)
+      {
+        width.reserve (n);
+        for (let const &f : files)
+          width.push_back (unicode::display_width (f._path));
+      }
+  }
+
+  def version_key (std::uint32_t i) const -> std::span<const NaturalSegment>
+  {
+    return {segments.data () + version[i].first, version[i].second};
+  }
+
+  arena::string names {};
+  arena::vector<std::string_view> name {};
+  arena::vector<std::string_view> extension {};
+  arena::vector<int> width {};
+  arena::vector<NaturalSegment> segments {};
+  // Range of each file's segments in `segments`
+  arena::vector<std::pair<std::size_t, std::size_t>> version {};
+};
+
+
+// Sorts by name, size, time or width with radix sorts.  The secondary key
+// (the name) is sorted first and the primary key with a stable radix sort
+// after that, which gives the same order as the comparators.
+static def radix_sort_files (FileList &files) -> void
 {
-  let const &astr = a.native ();
-  let const &bstr = b.native ();
-  let const l = std::min (astr.size (), bstr.size ());
-  fs::path::value_type c1, c2;
+  let const &f = files.entries ();
+  let const keys = SortKeys (f);
+  let &order = files.order ();
 
-  for (std::size_t i = 0; i < l; ++i)
+  if (Arguments::sort_mode == SortMode::width)
     {
-      c1 = static_cast<char32_t> (astr[i]) < 0x80 ? std::tolower (astr[i]) : astr[i];
-      c2 = static_cast<char32_t> (bstr[i]) < 0x80 ? std::tolower (bstr[i]) : bstr[i];
+      // Ignores --reverse, like the comparator
+      radix::sort_strings (order, keys.name, false);
+      arena::vector<std::uint64_t> widths (keys.width.begin (), keys.width.end ());
+      radix::sort_by_key (order, widths);
+      return;
+    }
+
+  radix::sort_strings (order, keys.name, Arguments::reverse);
+  if (Arguments::sort_mode == SortMode::name)
+    return;
 
-      if (c1 < c2)
-        return -1;
-      else if (c1 > c2)
-        return 1;
+  // Largest or newest first unless reversed
+  let const flip = Arguments::reverse ? std::uint64_t (0) : ~std::uint64_t (0);
+  arena::vector<std::uint64_t> primary;
+  primary.reserve (f.size ());
+  if (Arguments::sort_mode == SortMode::size)
+    {
+      for (let const &file : f)
+        primary.push_back (file.size ^ flip);
+    }
+  else
+    {
+      // Flip the sign bit so signed times are ordered as unsigned numbers
+      for (let const &file : f)
+        primary.push_back ((static_cast<std::uint64_t> (file.time)
+                            ^ (std::uint64_t (1) << 63))
+                           ^ flip);
     }
-  return astr.size () - bstr.size ();
+  radix::sort_by_key (order, primary);
 }
 
 
 def sort_files (FileList &files) -> void
 {
-  static std::function<bool (const FileInfo &, const FileInfo &)> sort = nullptr;
+  stats::Timer timer (stats::sort);
+  // Below this the comparison sort is faster
+  let constexpr radix_threshold = 64;
 
-  let compare_path = [](const fs::path &a, const fs::path &b) -> int {
-    if (Arguments::case_sensitive)
-      return a.compare (b);
-    else
-      return case_insensitive_compare (a, b);
+  // Turn a three-way comparison into a less-than, honoring --reverse
+  let const ordered = [](int c) -> bool {
+    return Arguments::reverse ? c > 0 : c < 0;
   };
 
-  #define SORT_FUNC [&compare_path](const FileInfo &a, const FileInfo &b)
-  if (!sort)
+  if (files.size () >= radix_threshold
+      && (Arguments::sort_mode == SortMode::name
+          || Arguments::sort_mode == SortMode::size
+          || Arguments::sort_mode == SortMode::time
+          || Arguments::sort_mode == SortMode::width))
+    radix_sort_files (files);
+  else if (Arguments::sort_mode != SortMode::none)
     {
+      let const &f = files.entries ();
+      let const keys = SortKeys (f);
+      let const &name = keys.name;
+
+      #define SORT_FUNC [&](std::uint32_t a, std::uint32_t b) -> bool
       switch (Arguments::sort_mode)
         {
           break; case SortMode::name:
-            sort = SORT_FUNC {
-              return (compare_path (a._path, b._path) < 0) ^ Arguments::reverse;
-            };
+            files.sort_indices (SORT_FUNC {
+              return ordered (name[a].compare (name[b]));
+            });
 
           break; case SortMode::extension:
-            sort = SORT_FUNC {
-              let const c = compare_path (a._path.extension (),
-                                          b._path.extension ());
+            files.sort_indices (SORT_FUNC {
+              let const c = keys.extension[a].compare (keys.extension[b]);
               // If both extensions are equal, compare the entire filename
-              return (((c ? c : compare_path (a._path, b._path)) < 0)
-                      ^ Arguments::reverse);
-            };
+              return ordered (c ? c : name[a].compare (name[b]));
+            });
 
           break; case SortMode::size:
-            sort = SORT_FUNC {
+            files.sort_indices (SORT_FUNC {
               // If both sizes are equal, compare the filename
-              return ((a.size == b.size
-                       ? compare_path (a._path, b._path) < 0
-                       : a.size > b.size)
-                      ^ Arguments::reverse);
-            };
+              return ordered (f[a].size == f[b].size
+                              ? name[a].compare (name[b])
+                              : (f[a].size > f[b].size ? -1 : 1));
+            });
 
           break; case SortMode::time:
-            sort = SORT_FUNC {
-              let const d = difftime (a.time, b.time);
+            files.sort_indices (SORT_FUNC {
               // If both times are equal, compare the file name
-              return ((d ? d > 0 : compare_path (a._path, b._path) < 0)
-                      ^ Arguments::reverse);
-            };
+              return ordered (f[a].time == f[b].time
+                              ? name[a].compare (name[b])
+                              : (f[a].time > f[b].time ? -1 : 1));
+            });
 
           break; case SortMode::version:
-            sort = SORT_FUNC {
-              (void)compare_path;  // Suppress unused capture warning
-              return ((natural_compare (a._path.filename (),
-                                       b._path.filename ()) < 0)
-                      ^ Arguments::reverse);
-            };
+            files.sort_indices (SORT_FUNC {
+              return ordered (natural_compare (keys.version_key (a),
+                                               keys.version_key (b)));
+            });
 
           break; case SortMode::width:
-            sort = SORT_FUNC {
-              let const awidth = unicode::display_width (unicode::path_to_str (a._path));
-              let const bwidth = unicode::display_width (unicode::path_to_str (b._path));
-              return (awidth == bwidth
-                      ? compare_path (a._path, b._path) < 0
-                      : awidth < bwidth);
-            };
+            files.sort_indices (SORT_FUNC {
+              return (keys.width[a] == keys.width[b]
+                      ? name[a].compare (name[b]) < 0
+                      : keys.width[a] < keys.width[b]);
+            });
 
           break; case SortMode::none:;
         }
+      #undef SORT_FUNC
     }
-  #undef SORT_FUNC
 
-  if (Arguments::sort_mode != SortMode::none)
-    files.sort (sort);
+  // -U lists entries in directory order, without grouping them either
+  if (Arguments::group_directories_first
+      && Arguments::sort_mode != SortMode::none)
+    files.partition ([](const FileInfo &f) {
+      return (f.type == fs::file_type::directory) != Arguments::reverse;
+    });
+}
+
 
+#ifndef _WIN32
+// Compares two names like the collated sort keys do
+static def compare_collated (std::string_view a, std::string_view b) -> int
+{
+  let const n = std::min (a.size (), b.size ());
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      let const ca = static_cast<unsigned char> (collate (a[i]));
+      let const cb = static_cast<unsigned char> (collate (b[i]));
+      if (ca != cb)
+        return ca < cb ? -1 : 1;
+    }
+  return a.size () < b.size () ? -1 : a.size () > b.size ();
+}
+
+
+// Whether sort_files puts `a` before `b`, for single files added to a sorted
+// list.  This has to agree with the sorts above.
+static def sorts_before (const FileInfo &a, const FileInfo &b) -> bool
+{
   if (Arguments::group_directories_first)
-    files.sort ([](const FileInfo &a, const FileInfo &b) {
-      return (((a.type == fs::file_type::directory)
-               > (b.type == fs::file_type::directory))
-              ^ Arguments::reverse);
-    });
+    {
+      let const a_first = (a.type == fs::file_type::directory) != Arguments::reverse;
+      let const b_first = (b.type == fs::file_type::directory) != Arguments::reverse;
+      if (a_first != b_first)
+        return a_first;
+    }
+
+  let const ordered = [](int c) -> bool {
+    return Arguments::reverse ? c > 0 : c < 0;
+  };
+  let const names = compare_collated (a._path, b._path);
+  switch (Arguments::sort_mode)
+    {
+      case SortMode::name:
+        return ordered (names);
+
+      case SortMode::extension:
+        {
+          let const ea = extension::of (a.file_name ());
+          let const eb = extension::of (b.file_name ());
+          let const c = compare_collated (
+            std::string_view (a._path).substr (a._path.size () - ea.size ()),
+            std::string_view (b._path).substr (b._path.size () - eb.size ()));
+          return ordered (c ? c : names);
+        }
+
+      case SortMode::size:
+        return ordered (a.size == b.size ? names : (a.size > b.size ? -1 : 1));
+
+      case SortMode::time:
+        return ordered (a.time == b.time ? names : (a.time > b.time ? -1 : 1));
+
+      case SortMode::version:
+        {
+          // Split like SortKeys does, so both sorts use the same comparison
+          arena::vector<NaturalSegment> as, bs;
+          natural_split (a.file_name (), as);
+          natural_split (b.file_name (), bs);
+          return ordered (natural_compare (as, bs));
+        }
+
+      case SortMode::width:
+        {
+          let const wa = unicode::display_width (a._path);
+          let const wb = unicode::display_width (b._path);
+          return wa == wb ? names < 0 : wa < wb;
+        }
+
+      case SortMode::none:
+        return false;
+    }
+  return false;
+}
+
+
+def insert_entries (FileList &files, int dir_fd, const fs::path &dir,
+                    std::span<const std::string> names)
+  -> std::vector<std::optional<std::uint32_t>>
+{
+  std::vector<std::optional<std::uint32_t>> added;
+  added.reserve (names.size ());
+  let &order = files.order ();
+  let const old_size = order.size ();
+  for (let const &name : names)
+    {
+      if (is_ignored (name))
+        {
+          added.emplace_back ();
+          continue;
+        }
+      FileStatus st (dir_fd, dir, name.c_str (), fs::file_type::unknown);
+      if (st.error == std::errc::no_such_file_or_directory)
+        {
+          added.emplace_back ();
+          continue;
+        }
+      files.add (st);
+      added.emplace_back (order.back ());
+    }
+
+  // -U appends, like new entries at the end of the directory
+  if (Arguments::sort_mode != SortMode::none && order.size () > old_size)
+    {
+      let const &f = files.entries ();
+      let const less = [&f](std::uint32_t a, std::uint32_t b) {
+        return sorts_before (f[a], f[b]);
+      };
+      let const middle = order.begin () + old_size;
+      std::stable_sort (middle, order.end (), less);
+      std::inplace_merge (order.begin (), middle, order.end (), less);
+    }
+  return added;
 }
+#endif // !_WIN32
 
 
 static def file_type_letter (const FileInfo &f) -> char
@@ -778,53 +1954,23 @@ static def file_indicator_color (const FileInfo &f) -> const char *
 }
 
 
-static def regular_file_icon (const fs::path &p) {
-  using Map = std::unordered_map<Path_String_View, const char *>;
-#ifdef _WIN32
-#  define V(quote) L##quote##sv
-#else
-#  define V(quote) quote##sv
-#endif
-  static const Map by_name = {
-    { V("LICENSE"), "\uF43D" }, // nf-oct-key
-    { V(".gitignore") , "\uF1D3" }, // nf-fa-git
-    { V(".gitmodules") , "\uF1D3" },
-  };
-  static const Map by_extension = {
-    // Text files
-    { V(".txt"), "\uF0F6" }, // nf-fa-file_text_o
-    { V(".md"), "\uF0F6" },
-    // Image files
-    { V(".jpg"), "\uF1C5" }, // nf-fa-file_image_o
-    { V(".jpeg"), "\uF1C5" },
-    { V(".jfif"), "\uF1C5" },
-    { V(".bmp"), "\uF1C5" },
-    { V(".png"), "\uF1C5" },
-    { V(".ppm"), "\uF1C5" },
-    { V(".tif"), "\uF1C5" },
-    { V(".tiff"), "\uF1C5" },
-    { V(".gif"), "\uF1C5" },
-    { V(".svg"), "\uF1C5" },
-    // Video files
-    { V(".mp4"), "\uF1C8" }, // nf-fa-file_video_o
-    { V(".webm"), "\uF1C8" },
-    { V(".mov"), "\uF1C8" },
-    // Audio files
-    { V(".mp3"), "\uF1C7" }, // nf-fa-file_audio_o
-    { V(".wav"), "\uF1C7" },
-    // Archive files
-    { V(".zip"), "\uF1C6" }, // nf-fa-file_archive_o
-    { V(".7z"), "\uF1C6" },
-    { V(".tar"), "\uF1C6" },
-    { V(".gz"), "\uF1C6" },
-    { V(".bz2"), "\uF1C6" },
-  };
-#undef V
-  if (let const it = by_name.find (p.filename ().native ()); it != by_name.end ())
-    return it->second;
-  if (let const it = by_extension.find (p.extension ().native ()); it != by_extension.end ())
-    return it->second;
-  return "\uF016"; // nf-fa-file_o
+static def regular_file_icon (const FileInfo &f) -> const char *
+{
+  let const file_name = f.file_name ();
+  if (file_name == "LICENSE"sv)
+    return "\uF43D"; // nf-oct-key
+  if (file_name == ".gitignore"sv || file_name == ".gitmodules"sv)
+    return "\uF1D3"; // nf-fa-git
+
+  switch (f.extension_kind)
+    {
+      case extension::Kind::text:    return "\uF0F6"; // nf-fa-file_text_o
+      case extension::Kind::image:   return "\uF1C5"; // nf-fa-file_image_o
+      case extension::Kind::video:   return "\uF1C8"; // nf-fa-file_video_o
+      case extension::Kind::audio:   return "\uF1C7"; // nf-fa-file_audio_o
+      case extension::Kind::archive: return "\uF1C6"; // nf-fa-file_archive_o
+      default:                       return "\uF016"; // nf-fa-file_o
+    }
 }
 
 
@@ -848,7 +1994,7 @@ static def file_icon (const FileInfo &f) -> const char *
       case fs::file_type::fifo:      return "\uFCE3"; // nf-mdi-pipe
       case fs::file_type::socket:    return "\uFBF1"; // nf-mdi-network
       case fs::file_type::not_found: return "\x1b[91m\uFB12\x1b[0m"; // nf-mdi-file_hidden
-      default:                       return regular_file_icon (f._path);
+      default:                       return regular_file_icon (f);
     }
 }
 
@@ -880,33 +2026,30 @@ static def file_name_width (const FileInfo &f) -> int
 
 def print_file_name (const FileInfo &f, bool have_quoted, int width) -> void
 {
-  static arena::string padding_buffer;
   // File name
   if (Arguments::color)
-    std::fputs (file_color (f), stdout);
+    G_out.put (file_color (f));
   if (Arguments::file_icons)
     {
-      std::fputs (file_icon (f), stdout);
+      G_out.put (file_icon (f));
       if (!have_quoted || !(f.name.front () == '\'' || f.name.front () == '"'))
-        std::putchar (' ');
+        G_out.put (' ');
     }
   else
     {
       if (have_quoted && !(f.name.front () == '\'' || f.name.front () == '"'))
-        std::putchar (' ');
+        G_out.put (' ');
     }
   if (Arguments::hyperlinks)
     {
-      std::error_code error;
-      let link_path = fs::weakly_canonical (f._path, error);
-      if (error)
-        link_path = f._path;
-      std::printf ("\x1b]8;;file:///%s\x1b\\%s\x1b]8;;\x1b\\",
-                  unicode::path_to_str (link_path).c_str (),
-                  f.name.c_str ());
+      G_out.put ("\x1b]8;;"sv);
+      G_out.put (hyperlink::file_uri (f));
+      G_out.put ("\x1b\\"sv);
+      G_out.put (f.name);
+      G_out.put ("\x1b]8;;\x1b\\"sv);
     }
   else
-    std::fputs (f.name.c_str (), stdout);
+    G_out.put (f.name);
   // Indicator
   if (Arguments::classify
       && !(Arguments::long_listing && f.type == fs::file_type::symlink && f.target))
@@ -915,18 +2058,18 @@ def print_file_name (const FileInfo &f, bool have_quoted, int width) -> void
         {
           let const color = file_indicator_color (f);
           if (color)
-            std::fputs (color, stdout);
+            G_out.put (color);
         }
       let const indicator = file_indicator (f);
       if (indicator)
-        std::putchar (indicator);
+        G_out.put (indicator);
     }
   // Link target
   if (f.target && (Arguments::long_listing || Arguments::single_column))
     {
       if (Arguments::color)
-        std::fputs (text_color, stdout);
-      std::fputs (" -> ", stdout);
+        G_out.put (text_color);
+      G_out.put (" -> ");
       print_file_name (*f.target, false);
     }
   // Padding
@@ -935,9 +2078,7 @@ def print_file_name (const FileInfo &f, bool have_quoted, int width) -> void
       let const w = file_name_width (f);
       if (w >= width)
         return;
-      padding_buffer.assign (width - w, ' ');
-      const char *padding = padding_buffer.c_str ();
-      std::fputs (padding, stdout);
+      G_out.fill (' ', width - w);
     }
 }
 
@@ -959,74 +2100,88 @@ static def int_len (std::uintmax_t n) -> int
   if (n < 10'000'000'000'000ULL) return 13;
   if (n < 100'000'000'000'000ULL) return 14;
   if (n < 1'000'000'000'000'000ULL) return 15;
-  return 18;
+  if (n < 10'000'000'000'000'000ULL) return 16;
+  if (n < 100'000'000'000'000'000ULL) return 17;
+  if (n < 1'000'000'000'000'000'000ULL) return 18;
+  if (n < 10'000'000'000'000'000'000ULL) return 19;
+  return 20;
 }
 
 
-// If 'dry' is true, nothing will be printed but the number of characters that
-// would have been written is still returned.
-template <bool dry = false>
-static def print_size (std::uintmax_t size, unsigned width = 0) -> int
+// Writes the decimal digits of `n` to `out` and returns their number
+static def write_number (std::uintmax_t n, char *out) -> int
 {
-  if (Arguments::human_readble && size >= Arguments::human_readble)
-    {
-      let fsize = double (size);
-      let p = 0;
-      while (fsize >= Arguments::human_readble)
-        {
-          ++p;
-          fsize /= Arguments::human_readble;
-        }
+  let const length = int_len (n);
+  for (let i = length - 1; i >= 0; --i, n /= 10)
+    out[i] = static_cast<char> ('0' + n % 10);
+  return length;
+}
 
-      let unit = (Arguments::human_readble == 1000 ? units_1000 : units_1024)[p - 1];
-      let unit_len = static_cast<int> (std::strlen (unit));
 
-      if constexpr (dry)
-        return std::snprintf (nullptr, 0, "%*.1f%s", width, fsize, unit);
-      else
-        {
-          if (Arguments::color)
-            return std::printf ("%s%*.1f%s", file_size_color,
-                                width - unit_len, fsize, unit);
-          else
-            return std::printf ("%*.1f%s", width - unit_len, fsize, unit);
-        }
-    }
-  else
+// Writes the text of the size column to `out` which must hold at least 32
+// characters and returns its length.  Human readable sizes have one decimal,
+// rounded half to even like printf does.
+static def format_size (std::uintmax_t size, char *out) -> int
+{
+  let const base = Arguments::human_readble;
+  if (!base || size < base)
+    return write_number (size, out);
+
+  let divisor = std::uintmax_t (1);
+  let p = 0;
+  while (size / divisor >= base)
     {
-      if constexpr (dry)
-        return std::snprintf (nullptr, 0, "%ju", size);
-      else
-        {
-          if (Arguments::color)
-            return std::printf ("%s%*ju", file_size_color, width, size);
-          else
-            return std::printf ("%*ju", width, size);
-        }
+      ++p;
+      divisor *= base;
     }
+
+  // Tenths of the size in units of `divisor`, without overflowing
+  let const remainder_tenths = size % divisor * 10;
+  let tenths = size / divisor * 10 + remainder_tenths / divisor;
+  let const rest = remainder_tenths % divisor;
+  if (rest * 2 > divisor || (rest * 2 == divisor && tenths % 2))
+    ++tenths;
+
+  let length = write_number (tenths / 10, out);
+  out[length++] = '.';
+  out[length++] = static_cast<char> ('0' + tenths % 10);
+  let const unit = (base == 1000 ? units_1000 : units_1024)[p - 1];
+  let const unit_len = static_cast<int> (std::strlen (unit));
+  std::memcpy (out + length, unit, unit_len);
+  return length + unit_len;
 }
 
 
-static def strftime_width (const std::tm *time) -> int
+// Formats `time` with the user's --time-format into `buf`
+static def format_time (const std::tm *time, arena::string &buf) -> std::string_view
 {
-  static arena::string S_buf;
-  static bool first_call = true;
-  if (first_call)
-    {
-      S_buf.resize (64);
-      first_call = false;
-    }
+  if (buf.size () < 64)
+    buf.resize (64);
 
-  let r = std::strftime (S_buf.data (), S_buf.size () - 1, Arguments::time_format, time);
+  let r = std::strftime (buf.data (), buf.size () - 1, Arguments::time_format, time);
 
   while (!r)
     {
-      S_buf.resize (S_buf.size () << 1);
-      r = std::strftime (S_buf.data (), S_buf.size () - 1, Arguments::time_format, time);
+      buf.resize (buf.size () << 1);
+      r = std::strftime (buf.data (), buf.size () - 1, Arguments::time_format, time);
     }
 
-  S_buf.resize (r);
-  return unicode::display_width (S_buf);
+  return {buf.data (), r};
+}
+
+
+static def print_lines (const FileList &files, bool has_quoted) -> void
+{
+  stats::Timer timer (stats::render);
+  for (let const &f : files)
+    {
+      if (f.status_failed && Arguments::color)
+        G_out.put ("\x1b[2m");
+      print_file_name (f, has_quoted);
+      if (f.status_failed && Arguments::color)
+        G_out.put ("\x1b[22m");
+      G_out.put ('\n');
+    }
 }
 
 
@@ -1044,51 +2199,82 @@ def print_single_column (const FileList &files) -> void
         }
     }
 
-  for (let const &f : files)
-    {
-      if (f.status_failed && Arguments::color)
-        std::fputs ("\x1b[2m", stdout);
-      print_file_name (f, has_quoted);
-      if (f.status_failed && Arguments::color)
-        std::fputs ("\x1b[22m", stdout);
-      std::putchar ('\n');
-    }
+  print_lines (files, has_quoted);
 }
 
 
 def print_long (const FileList &files) -> void
 {
-  arena::string size_buf;
-  bool invalid_time = false;
+  stats::Timer timer (stats::render);
   bool has_quoted = false;
 
   int name_width = 0, link_width = 0, owner_width = 0, group_width = 0,
-      size_width = 0, time_width = Arguments::time_format ? 0 : 13;
+      size_width = 0,
+      time_width = Arguments::time_format ? 0 : timestamp::default_width;
 
   let const name_is_last = Arguments::long_columns.back () == LongColumn::name;
+  let const show_size = Arguments::long_columns_has.test (LongColumn::size);
+  let const show_date = Arguments::long_columns_has.test (LongColumn::date);
+
+  // The size and date texts are rendered once, while measuring the columns,
+  // and printed from here.
+  struct Rendered
+  {
+    std::uint32_t size_begin;
+    std::uint32_t date_begin;
+    std::uint16_t size_length;
+    std::uint16_t date_length;
+    int name_width;
+  };
+  arena::vector<Rendered> rendered;
+  rendered.reserve (files.size ());
+  arena::string texts;
+  char buf[32];
+  arena::string date_buf;
 
   // Get column widths
   for (let const &f : files)
     {
+      let &r = rendered.emplace_back ();
       if (Arguments::long_columns_has.test (LongColumn::name) && !name_is_last)
-        name_width = std::max (name_width, file_name_width (f));
+        {
+          r.name_width = file_name_width (f);
+          name_width = std::max (name_width, r.name_width);
+        }
       if (Arguments::long_columns_has.test (LongColumn::hard_link_count))
         link_width = std::max (link_width, int_len (f.link_count));
       if (Arguments::long_columns_has.test (LongColumn::owner_name))
         owner_width = std::max (owner_width, unicode::display_width (f.owner));
       if (Arguments::long_columns_has.test (LongColumn::group_name))
         group_width = std::max (group_width, unicode::display_width (f.group));
-      if (Arguments::long_columns_has.test (LongColumn::size))
+      if (show_size)
         {
           if (f.type == fs::file_type::directory)
             size_width = std::max (size_width, 5);
           else
-            size_width = std::max (size_width, print_size<true> (f.size));
+            {
+              let const length = format_size (f.size, buf);
+              r.size_begin = static_cast<std::uint32_t> (texts.size ());
+              r.size_length = static_cast<std::uint16_t> (length);
+              texts.append (buf, length);
+              size_width = std::max (size_width, length);
+            }
         }
-      if (Arguments::time_format && !f.status_failed && f.time)
+      if (show_date && !f.status_failed && f.time)
         {
-          let const t = std::localtime (&f.time);
-          time_width = std::max (time_width, strftime_width (t));
+          r.date_begin = static_cast<std::uint32_t> (texts.size ());
+          if (Arguments::time_format)
+            {
+              std::tm t;
+              timestamp::local_time (f.time, t);
+              let const time = format_time (&t, date_buf);
+              texts.append (time);
+              time_width = std::max (time_width, unicode::display_width (time));
+            }
+          else
+            texts.append (buf, timestamp::format_default (f.time, G_six_months_ago,
+                                                          buf));
+          r.date_length = static_cast<std::uint16_t> (texts.size () - r.date_begin);
         }
       if (!has_quoted
            && (Arguments::quoting == QuoteMode::default_)
@@ -1097,19 +2283,15 @@ def print_long (const FileList &files) -> void
         has_quoted = true;
     }
 
-  let const date_sz = time_width + 1;
-  static arena::string date_buf_s;
-  date_buf_s.resize (date_sz);
-  let const date_buf = date_buf_s.data ();
+  let const text = [&texts](std::uint32_t begin, std::uint16_t length) {
+    return std::string_view (texts).substr (begin, length);
+  };
 
+  let r = rendered.cbegin ();
   for (let const &f : files)
     {
-      if (f.status_failed)
-        {
-          invalid_time = true;
-          if (Arguments::color)
-            std::fputs ("\x1b[2m", stdout);
-        }
+      if (f.status_failed && Arguments::color)
+        G_out.put ("\x1b[2m");
 
       for (let const &col : Arguments::long_columns)
         {
@@ -1118,31 +2300,31 @@ def print_long (const FileList &files) -> void
               case LongColumn::type_indicator:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
-                  std::putchar (file_type_letter (f));
+                    G_out.put (text_color);
+                  G_out.put (file_type_letter (f));
                 }
                 break;
 
               case LongColumn::rwx_perms:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
-                  std::putchar ((f.perms & fs::perms::owner_read) != fs::perms::none ? 'r' : '-');
-                  std::putchar ((f.perms & fs::perms::owner_write) != fs::perms::none ? 'w' : '-');
-                  std::putchar ((f.perms & fs::perms::owner_exec) != fs::perms::none ? 'x' : '-');
-                  std::putchar ((f.perms & fs::perms::group_read) != fs::perms::none ? 'r' : '-');
-                  std::putchar ((f.perms & fs::perms::group_write) != fs::perms::none ? 'w' : '-');
-                  std::putchar ((f.perms & fs::perms::group_exec) != fs::perms::none ? 'x' : '-');
-                  std::putchar ((f.perms & fs::perms::others_read) != fs::perms::none ? 'r' : '-');
-                  std::putchar ((f.perms & fs::perms::others_write) != fs::perms::none ? 'w' : '-');
-                  std::putchar ((f.perms & fs::perms::others_exec) != fs::perms::none ? 'x' : '-');
+                    G_out.put (text_color);
+                  G_out.put ((f.perms & fs::perms::owner_read) != fs::perms::none ? 'r' : '-');
+                  G_out.put ((f.perms & fs::perms::owner_write) != fs::perms::none ? 'w' : '-');
+                  G_out.put ((f.perms & fs::perms::owner_exec) != fs::perms::none ? 'x' : '-');
+                  G_out.put ((f.perms & fs::perms::group_read) != fs::perms::none ? 'r' : '-');
+                  G_out.put ((f.perms & fs::perms::group_write) != fs::perms::none ? 'w' : '-');
+                  G_out.put ((f.perms & fs::perms::group_exec) != fs::perms::none ? 'x' : '-');
+                  G_out.put ((f.perms & fs::perms::others_read) != fs::perms::none ? 'r' : '-');
+                  G_out.put ((f.perms & fs::perms::others_write) != fs::perms::none ? 'w' : '-');
+                  G_out.put ((f.perms & fs::perms::others_exec) != fs::perms::none ? 'x' : '-');
                 }
                 break;
 
               case LongColumn::oct_perms:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
+                    G_out.put (text_color);
                   let static constexpr owner_mask = (fs::perms::owner_read
                                                      | fs::perms::owner_write
                                                      | fs::perms::owner_exec);
@@ -1152,44 +2334,35 @@ def print_long (const FileList &files) -> void
                   let static constexpr others_mask = (fs::perms::others_read
                                                       | fs::perms::others_write
                                                       | fs::perms::others_exec);
-                  std::printf ("%c%c%c",
-                               '0' + (static_cast<int> (f.perms & owner_mask) >> 6),
-                               '0' + (static_cast<int> (f.perms & group_mask) >> 3),
-                               '0' + (static_cast<int> (f.perms & others_mask)));
+                  G_out.put ('0' + (static_cast<int> (f.perms & owner_mask) >> 6));
+                  G_out.put ('0' + (static_cast<int> (f.perms & group_mask) >> 3));
+                  G_out.put ('0' + (static_cast<int> (f.perms & others_mask)));
                 }
                 break;
 
               case LongColumn::hard_link_count:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
-                  std::printf ("%*d", link_width, f.link_count);
+                    G_out.put (text_color);
+                  G_out.number (f.link_count, link_width);
                 }
                 break;
 
               case LongColumn::owner_name:
                 {
                   if (Arguments::color)
-                    std::fputs (f.group == "?"sv
-                                  ? error_color
-                                  : name_color,
-                                stdout);
-                  std::printf ("%*s",
-                               owner_width + unicode::padding_offset (f.owner),
-                               f.owner.c_str ());
+                    G_out.put (f.group == "?"sv ? error_color : name_color);
+                  G_out.right (f.owner,
+                               owner_width + unicode::padding_offset (f.owner));
                 }
                 break;
 
               case LongColumn::group_name:
                 {
                   if (Arguments::color)
-                    std::fputs (f.group == "?"sv
-                                  ? error_color
-                                  : name_color,
-                                stdout);
-                  std::printf ("%*s",
-                               group_width + unicode::padding_offset (f.group),
-                               f.group.c_str ());
+                    G_out.put (f.group == "?"sv ? error_color : name_color);
+                  G_out.right (f.group,
+                               group_width + unicode::padding_offset (f.group));
                 }
                 break;
 
@@ -1198,76 +2371,64 @@ def print_long (const FileList &files) -> void
                   if (f.type == fs::file_type::directory)
                     {
                       if (Arguments::color)
-                        std::printf ("%s%*s", dir_size_color,
-                                     size_width, "<DIR>");
-                      else
-                        std::printf ("%*s", size_width, "<DIR>");
+                        G_out.put (dir_size_color);
+                      G_out.right ("<DIR>"sv, size_width);
                     }
                   else
-                    print_size (f.size, size_width);
+                    {
+                      if (Arguments::color)
+                        G_out.put (file_size_color);
+                      G_out.right (text (r->size_begin, r->size_length),
+                                   size_width);
+                    }
                 }
                 break;
 
               case LongColumn::date:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
-                  if (invalid_time || !f.time)
+                    G_out.put (text_color);
+                  if (f.status_failed || !f.time)
                     {
                       if (Arguments::color)
-                        std::printf ("%s%*c", error_color, time_width, '?');
-                      else
-                        std::printf ("%*c", time_width, '?');
-                      invalid_time = false;
+                        G_out.put (error_color);
+                      G_out.right ("?"sv, time_width);
                     }
                   else
                     {
-                      std::memset (date_buf, 0, date_sz);
-                      let const t = std::localtime (&f.time);
-                      if (Arguments::time_format)
-                        {
-                          std::strftime (date_buf, date_sz, Arguments::time_format, t);
-                        }
-                      else
-                        {
-                          if (difftime (f.time, G_six_months_ago) < 0)
-                            std::strftime (date_buf, date_sz, "%d. %b  %Y", t);
-                          else
-                            std::strftime (date_buf, date_sz, "%d. %b %H:%M", t);
-                      }
-                      std::fputs (date_buf, stdout);
+                      G_out.put (text (r->date_begin, r->date_length));
                     }
                 }
                 break;
 
               case LongColumn::name:
                 {
-                  print_file_name (f, has_quoted, name_width);
+                  print_file_name (f, has_quoted);
+                  if (!name_is_last && r->name_width < name_width)
+                    G_out.fill (' ', name_width - r->name_width);
                 }
                 break;
 
               case LongColumn::text:
                 {
                   if (Arguments::color)
-                    std::fputs (text_color, stdout);
+                    G_out.put (text_color);
                   let const text = col.get_text ();
-                  if (text.size () == 1)
-                    std::putchar (text.front ());
-                  else
-                    std::printf ("%.*s", static_cast<int> (text.size ()),
-                                 text.data ());
+                  G_out.put (text);
                 }
                 break;
             }
         }
       if (f.status_failed && Arguments::color)
-        std::fputs ("\x1b[22m", stdout);
-      std::putchar ('\n');
+        G_out.put ("\x1b[22m");
+      G_out.put ('\n');
+      ++r;
     }
 }
 
 def print_columns (const FileList &files) -> void
 {
+  stats::Timer timer (stats::render);
   if (files.empty ())
     return;
   Columns cols;
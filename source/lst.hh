@@ -1,5 +1,6 @@
 #pragma once
 #include "args.hh"
+#include "extension.hh"
 #include "unicode.hh"
 #include "options.hh"
 
@@ -12,35 +13,206 @@ enum class PathExists
   NoAccess,
 };
 
+#ifndef _WIN32
+// Result of a stat call made ahead of time for a batch of entries
+struct PrefetchedStat;
+
+namespace cache { struct Entry; }
+#endif
+
+// Result of the status queries for a file.  This is gathered separately from
+// the FileInfo so the traversal workers can do the system calls; the FileInfo
+// itself (which allocates from the arena and looks up user names) is always
+// constructed on the main thread.
+struct FileStatus
+{
+  FileStatus (const fs::path &p, const fs::file_status &in_s);
+
+#ifndef _WIN32
+  // Status of the entry `name` of the directory `dir_fd`, where `dir` is the
+  // path of that directory as given.  `type` is the type reported by readdir,
+  // if known.  If `prefetched` is given it replaces the first stat call.
+  FileStatus (int dir_fd, const fs::path &dir, const char *name,
+              fs::file_type type, const PrefetchedStat *prefetched = nullptr);
+
+  // Status of an entry of the directory `dir` as read from the cache
+  FileStatus (const fs::path &dir, const cache::Entry &e);
+#endif
+
+  fs::path path;
+  // Whether this is an entry of a directory listing, as opposed to a file
+  // named on the command line
+  bool in_directory { false };
+  // Status of the entry itself, as reported by the directory iterator
+  fs::file_status in_s;
+  // Status honoring --dereference
+  fs::file_status s {};
+  std::error_code error {};
+#ifndef _WIN32
+  struct stat sb;
+#endif
+  // Link target as read from the link, only set for long listings
+  fs::path link_target {};
+  fs::file_status link_target_s {};
+  // Link target for name dependant file types with --dereference
+  fs::path deref_target {};
+
+private:
+#ifndef _WIN32
+  def init (int dir_fd, const char *name, const PrefetchedStat *prefetched) -> void;
+#endif
+};
+
 struct FileInfo
 {
   struct link_target_tag {};
 
   FileInfo (const fs::path &p, const fs::file_status &s, link_target_tag);
 
-public:
-  FileInfo (const fs::path &p, const fs::file_status &in_s);
+  FileInfo (const FileStatus &st);
 
-  ~FileInfo ();
+  // The file name part of `_path`
+  def file_name () const -> std::string_view;
 
   arena::string name {};
-  // Target of link or shortcut
-  FileInfo *target { nullptr };
-  arena::string owner { "?" };
-  arena::string group { "?" };
+  // Target of link or shortcut, owned by the FileList
+  const FileInfo *target { nullptr };
+  // Interned names, see owners.hh
+  std::string_view owner { "?"sv };
+  std::string_view group { "?"sv };
   std::uintmax_t size {0};
   std::time_t time {0};
   fs::file_type type { fs::file_type::unknown };
   unsigned link_count {0};
   fs::perms perms { fs::perms::none };
-  // Used for sorting
-  const fs::path _path;
+  // Used for sorting: the file name for directory entries, the absolute path
+  // otherwise.  For link targets of directory entries it is the link's text.
+  arena::string _path {};
+  // Absolute path of the directory `_path` is relative to, null if `_path`
+  // is absolute
+  const fs::path *_directory { nullptr };
+  // Kind of the extension of the file name
+  extension::Kind extension_kind { extension::Kind::none };
   bool status_failed { false };
   bool is_executable { false };
   bool is_temporary { false };
 };
 
-using FileList = std::list<FileInfo>;
+// The files of a single listing.  The FileInfo objects are stored
+// contiguously in the order they were added and sorting only reorders an
+// array of indices into them.  Link targets are kept in a separate container
+// so their addresses stay stable.
+class FileList
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = FileInfo;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const FileInfo *;
+    using reference = const FileInfo &;
+
+    iterator (const FileList *list, const std::uint32_t *pos)
+      : M_list (list), M_pos (pos)
+    {}
+
+    def operator * () const -> const FileInfo & { return M_list->M_files[*M_pos]; }
+    def operator -> () const -> const FileInfo * { return &**this; }
+    def operator ++ () -> iterator & { ++M_pos; return *this; }
+    def operator != (const iterator &other) const -> bool { return M_pos != other.M_pos; }
+    def operator == (const iterator &other) const -> bool { return M_pos == other.M_pos; }
+
+  private:
+    const FileList *M_list;
+    const std::uint32_t *M_pos;
+  };
+
+  FileList () = default;
+
+  FileList (const fs::path &directory)
+    : directory (directory)
+  {}
+
+  // Files refer to `directory` so the list must not move
+  FileList (const FileList &) = delete;
+
+  def add (const FileStatus &st) -> const FileInfo &;
+
+  def begin () const -> iterator { return iterator (this, M_order.data ()); }
+  def end () const -> iterator { return iterator (this, M_order.data () + M_order.size ()); }
+
+  def size () const -> std::size_t { return M_order.size (); }
+  def empty () const -> bool { return M_order.empty (); }
+
+  def clear () -> void
+  {
+    M_files.clear ();
+    M_order.clear ();
+    M_targets.clear ();
+  }
+
+  // The files in the order they were added; sort_indices works with
+  // indices into this.
+  def entries () const -> const arena::vector<FileInfo> & { return M_files; }
+
+  // Indices into entries () in their current order
+  def order () -> arena::vector<std::uint32_t> & { return M_order; }
+
+  // Stable sort with a comparator on indices into entries ()
+  template <class Compare>
+  def sort_indices (Compare comp) -> void
+  {
+    std::stable_sort (M_order.begin (), M_order.end (), comp);
+  }
+
+  // Stable partition, the files satisfying `pred` go first
+  template <class Predicate>
+  def partition (Predicate pred) -> void
+  {
+    std::stable_partition (M_order.begin (), M_order.end (),
+                           [this, &pred](std::uint32_t i) {
+                             return pred (M_files[i]);
+                           });
+  }
+
+  // Takes the files with the sorted indices `removed` into entries () out of
+  // the listing in one pass; they stay in entries () until the next compact.
+  def remove (std::span<const std::uint32_t> removed) -> void
+  {
+    std::erase_if (M_order, [removed](std::uint32_t i) {
+      return std::binary_search (removed.begin (), removed.end (), i);
+    });
+  }
+
+  // Drops the removed files and their link targets, after which entries ()
+  // is in the current order.
+  def compact () -> void
+  {
+    arena::vector<FileInfo> files;
+    decltype (M_targets) targets;
+    files.reserve (M_order.size ());
+    for (let const i : M_order)
+      {
+        let &f = files.emplace_back (std::move (M_files[i]));
+        if (f.target)
+          f.target = &targets.emplace_back (*f.target);
+      }
+    M_files = std::move (files);
+    M_targets = std::move (targets);
+    std::iota (M_order.begin (), M_order.end (), std::uint32_t (0));
+  }
+
+  // Absolute path of the listed directory, empty for the files named on the
+  // command line
+  fs::path directory {};
+
+private:
+  arena::vector<FileInfo> M_files;
+  arena::vector<std::uint32_t> M_order;
+  std::deque<FileInfo, arena::Allocator<FileInfo>> M_targets;
+};
 
 extern std::time_t G_six_months_ago;
 
@@ -48,9 +220,6 @@ extern std::time_t G_six_months_ago;
 extern IShellLink *G_sl;
 extern IPersistFile *G_pf;
 extern bool G_has_shortcut_interfaces;
-#else
-extern std::map<pid_t, arena::string> G_users;
-extern std::map<uid_t, arena::string> G_groups;
 #endif // _WIN32
 
 extern FileList G_singles;
@@ -64,9 +233,17 @@ def list_file (const fs::path &path) -> void;
 
 def list_dir (const fs::path &path) -> void;
 
+// Whether directories can be printed while they are read instead of being
+// collected into G_directories first; true for unsorted single column output.
+def can_stream () -> bool;
+
+// Prints the entries of a directory in batches as they are read.  `before` is
+// called once the directory could be opened, to print its label.
+def stream_dir (const fs::path &path, const std::function<void ()> &before) -> void;
+
 #ifdef _WIN32
-def get_owner_and_group (HANDLE file_handle, arena::string &owner_out,
-                         arena::string &group_out) -> bool;
+def get_owner_and_group (HANDLE file_handle, std::string_view &owner_out,
+                         std::string_view &group_out) -> bool;
 
 def get_file_time (HANDLE file_handle, std::time_t &out) -> bool;
 
@@ -78,8 +255,8 @@ def get_link_count (BY_HANDLE_FILE_INFORMATION *file_info) -> unsigned;
 
 #else // _WIN32
 
-def get_owner_and_group (struct stat *sb, arena::string &owner_out,
-                         arena::string &group_out) -> bool;
+def get_owner_and_group (struct stat *sb, std::string_view &owner_out,
+                         std::string_view &group_out) -> bool;
 
 def get_file_time (struct stat *sb, std::time_t &out) -> bool;
 
@@ -90,6 +267,16 @@ def get_link_count (struct stat *sb) -> unsigned;
 
 def sort_files (FileList &files) -> void;
 
+#ifndef _WIN32
+// Adds the entries `names` of the directory `dir_fd`, given as `dir`, to its
+// sorted listing `files` at the places sort_files would put them, merging
+// them in with a single pass.  Returns the index in files.entries () of each
+// name, or nullopt for those that are ignored or do not exist.
+def insert_entries (FileList &files, int dir_fd, const fs::path &dir,
+                    std::span<const std::string> names)
+  -> std::vector<std::optional<std::uint32_t>>;
+#endif
+
 def file_indicator (const FileInfo &f) -> char;
 
 def print_file_name (const FileInfo &f, bool have_quoted, int width = 0) -> void;
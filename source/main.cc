@@ -1,25 +1,110 @@
 #include "stdafx.hh"
 #include "lst.hh"
+#include "client.hh"
 #include "columns.hh"
+#include "output.hh"
+#include "server.hh"
+#include "stats.hh"
+#include "watch.hh"
 
-def main (const int argc, const char *argv[]) -> int
+// Lists `args` into G_singles and G_directories, or into `stream_dirs` for
+// the directories that are printed while reading them.  Returns whether the
+// directories need labels because of arguments that could not be listed.
+static def list_args (arena::vector<fs::path> &args,
+                      arena::vector<const fs::path *> &stream_dirs) -> bool
 {
-#ifdef _WIN32
-  SetConsoleOutputCP (CP_UTF8);
+  let need_label = false;
+  // Directories to print while reading them, see can_stream
+  let const streaming = can_stream ();
 
-  // ONLY FOR POWERSHELL:
-  // Windows gives us the full path of the executable which looks quite ugly in
-  // error messages so let's just use the file name.
-  // Sadly there is no way of checking if the program was launched by using
-  // just it's name or the full path.
-  //
-  // We do this for CMD as well anyways since checking which one was used to
-  // invoke the program takes too much processing effort.
-  // (who uses full paths on Windows anyways)
-  let const last_slash = std::string_view (argv[0]).rfind ('\\') + 1;
-  argv[0] += last_slash;
-#endif
+  for (let &a : args)
+    {
+      a.make_preferred ();
+      if (let exists = path_exists (a); exists != PathExists::Yes)
+        {
+          if (exists == PathExists::No)
+            G_out.format ("%s: '%s': No such file or directory\n", G_program,
+                          unicode::path_to_str (a).c_str ());
+          need_label = true;
+          continue;
+        }
+      else if (!Arguments::immediate_dirs && fs::is_directory (a))
+        {
+          if (!can_list (a))
+            {
+              need_label = true;
+              continue;
+            }
+          if (streaming)
+            stream_dirs.push_back (&a);
+          else
+            list_dir (a);
+        }
+      else
+        list_file (a);
+    }
+  return need_label;
+}
+
+
+// Prints what list_args listed, sorting it first unless it is `sorted`
+// already.
+static def print_listing (bool need_label,
+                          const arena::vector<const fs::path *> &stream_dirs,
+                          bool sorted = false) -> void
+{
+  void (*print_files) (const FileList &files) =
+    (Arguments::long_listing
+     ? print_long
+     : (Arguments::single_column
+        ? print_single_column
+        : print_columns
+    ));
+
+  if (!G_singles.empty ())
+    {
+      if (!sorted)
+        sort_files (G_singles);
+      print_files (G_singles);
+    }
+
+  need_label = need_label || (!G_singles.empty ()
+                              || G_directories.size () + stream_dirs.size () > 1);
+  let sep = !G_singles.empty ();
+
+  let const print_label = [&sep, need_label](const fs::path &path) {
+    if (sep)
+      G_out.put ('\n');
+    else
+      sep = true;
+
+    if (need_label)
+      {
+        G_out.put ("\x1b[0m"sv);
+        G_out.put (path.string ());
+        G_out.put (":\n"sv);
+      }
+  };
 
+  for (let &d : G_directories)
+    {
+      print_label (d.first);
+      if (!sorted)
+        sort_files (d.second);
+      print_files (d.second);
+    }
+
+  for (let const d : stream_dirs)
+    stream_dir (*d, [&print_label, d]() { print_label (*d); });
+  if (Arguments::color)
+    G_out.put ("\x1b[0m");
+  G_out.flush ();
+}
+
+
+// Everything after the platform setup, so the server can run it for requests
+static def run (const int argc, const char *argv[]) -> int
+{
   G_is_a_tty = isatty (fileno (stdout));
 
   arena::vector<fs::path> args;
@@ -30,6 +115,30 @@ def main (const int argc, const char *argv[]) -> int
       return 1;
     }
 
+#ifdef __linux__
+  if (server::in_request ())
+    {
+      // A watching listing stays with the client
+      if (Arguments::watch)
+        return client::not_served;
+    }
+  else if (Arguments::serve_socket)
+    {
+      if (argc != 2)
+        {
+          std::fprintf (stderr, "%s: ‘--serve’ takes no other arguments\n",
+                        G_program);
+          return 1;
+        }
+      return server::serve (Arguments::serve_socket, run);
+    }
+  else if (Arguments::client_socket && !Arguments::watch)
+    {
+      if (let const status = client::request (Arguments::client_socket, argc, argv))
+        return *status;
+    }
+#endif
+
   if (Arguments::long_listing)
     {
       if (!Arguments::time_format)
@@ -102,64 +211,63 @@ def main (const int argc, const char *argv[]) -> int
   if (args.empty ())
     args.emplace_back (".");
 
-  let need_label = false;
+  arena::vector<const fs::path *> stream_dirs;
+#ifdef __linux__
+  let listed_at = Arguments::watch ? watch::listing_time () : timespec {};
+#endif
+  let need_label = list_args (args, stream_dirs);
+  if (Arguments::watch && G_is_a_tty)
+    G_out.put ("\x1b[H\x1b[2J"sv);
+  print_listing (need_label, stream_dirs);
 
-  for (let &a : args)
+  if (Arguments::stats_mode != StatsMode::off)
+    stats::print (Arguments::stats_mode == StatsMode::json);
+
+#ifdef __linux__
+  if (Arguments::watch)
     {
-      a.make_preferred ();
-      if (let exists = path_exists (a); exists != PathExists::Yes)
+      // Each listing replaces the one before on a terminal
+      let const next_frame = []() {
+        G_out.put (G_is_a_tty ? "\x1b[H\x1b[2J"sv : "\n"sv);
+      };
+      let const redraw = [&]() {
+        next_frame ();
+        print_listing (need_label, stream_dirs, true);
+      };
+      while (watch::follow (redraw, listed_at))
         {
-          if (exists == PathExists::No)
-            std::printf ("%s: '%s': No such file or directory\n", G_program,
-                         unicode::path_to_str (a).c_str ());
-          need_label = true;
-          continue;
+          G_singles.clear ();
+          G_directories.clear ();
+          listed_at = watch::listing_time ();
+          need_label = list_args (args, stream_dirs);
+          next_frame ();
+          print_listing (need_label, stream_dirs);
         }
-      else if (!Arguments::immediate_dirs && fs::is_directory (a))
-        {
-          if (!can_list (a))
-            {
-              need_label = true;
-              continue;
-            }
-          list_dir (a);
-        }
-      else
-        list_file (a);
-    }
-
-  void (*print_files) (const FileList &files) =
-    (Arguments::long_listing
-     ? print_long
-     : (Arguments::single_column
-        ? print_single_column
-        : print_columns
-    ));
-
-  if (!G_singles.empty ())
-    {
-      sort_files (G_singles);
-      print_files (G_singles);
+      return 1;
     }
+#endif
 
-  need_label = need_label || (!G_singles.empty () || G_directories.size () > 1);
-  let sep = !G_singles.empty ();
+  return 0;
+}
 
-  for (let &d : G_directories)
-    {
-      if (sep)
-        std::putchar ('\n');
-      else
-        sep = true;
 
-      if (need_label)
-        std::printf ("\x1b[0m%s:\n", d.first.string ().c_str ());
+def main (const int argc, const char *argv[]) -> int
+{
+#ifdef _WIN32
+  SetConsoleOutputCP (CP_UTF8);
 
-      sort_files (d.second);
-      print_files (d.second);
-    }
-  if (Arguments::color)
-    std::fputs ("\x1b[0m", stdout);
+  // ONLY FOR POWERSHELL:
+  // Windows gives us the full path of the executable which looks quite ugly in
+  // error messages so let's just use the file name.
+  // Sadly there is no way of checking if the program was launched by using
+  // just it's name or the full path.
+  //
+  // We do this for CMD as well anyways since checking which one was used to
+  // invoke the program takes too much processing effort.
+  // (who uses full paths on Windows anyways)
+  let const last_slash = std::string_view (argv[0]).rfind ('\\') + 1;
+  argv[0] += last_slash;
+#endif
 
-  return 0;
+  return run (argc, argv);
 }
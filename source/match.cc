@@ -1,96 +1,180 @@
 #include "match.hh"
 
-static def range_match (std::string_view pattern, char test) -> std::size_t
+// Parses the bracket expression starting after the `[` at `pattern[i]` into
+// `set`.  Returns the index after the closing `]`, or 0 if there is none in
+// which case the `[` is taken literally.
+static def parse_range (std::string_view pattern, std::size_t i,
+                        std::bitset<256> &set) -> std::size_t
 {
-  let ok = false;
   let negate = false;
-  let i = std::size_t (0);
-
-  if (pattern[i] == '^' || pattern[i] == '!')
+  if (i < pattern.size () && (pattern[i] == '^' || pattern[i] == '!'))
     {
       negate = true;
       ++i;
     }
 
-  while (pattern[i] != ']')
+  set.reset ();
+  while (i < pattern.size () && pattern[i] != ']')
     {
-      if (ok)
+      if (pattern[i] == '\\' && i + 1 < pattern.size ())
         ++i;
-      else if (pattern[i] == '-')
+      let const lo = pattern[i++];
+      set.set (static_cast<unsigned char> (lo));
+      if (i + 1 < pattern.size () && pattern[i] == '-' && pattern[i + 1] != ']')
         {
-          if (test >= pattern[i-1] && test <= pattern[i+1])
-            ok = true;
-          i += 2;
-        }
-      else
-        {
-          if (pattern[i] == '\\')
+          if (pattern[i + 1] == '\\' && i + 2 < pattern.size ())
             ++i;
-          if (pattern[i] == test)
-            ok = true;
-          ++i;
+          let const hi = pattern[i + 1];
+          i += 2;
+          // Compared as `char` like the rest of the program does
+          for (let c = 0; c < 256; ++c)
+            {
+              let const ch = static_cast<char> (c);
+              if (ch >= lo && ch <= hi)
+                set.set (c);
+            }
         }
     }
+  if (i == pattern.size ())
+    return 0;
 
-  return ok == negate ? 0 : i + 1;
+  if (negate)
+    set.flip ();
+  return i + 1;
 }
 
-def match (std::string_view pattern, std::string_view string) -> bool
+def PatternSet::add (std::string_view pattern) -> void
 {
-  std::size_t i = 0, m = 0;
+  ++M_patterns;
+  let const first_state = M_enter.size ();
+
+  // Start state
+  M_enter.emplace_back ();
+  M_is_start.push_back (true);
+  M_is_loop.push_back (false);
+  M_is_accept.push_back (false);
+
+  std::bitset<256> set;
+  std::size_t i = 0;
   while (i < pattern.size ())
     {
       switch (pattern[i])
         {
-        case '?':
-          {
+          case '*':
+            M_is_loop.back () = true;
             ++i;
-            if (m == string.size ())
-              return false;
-            ++m;
-          }
-          break;
-
-        case '*':
-          {
-            while (i < pattern.size () && pattern[i] == '*')
-              ++i;
-            if (i == pattern.size ())
-              return true;
-            while (m < string.size ())
-              {
-                if (match (pattern.substr (i), string.substr (m)))
-                  return true;
-                ++m;
-              }
-            return false;
-          }
-          break;
-
-        case '[':
-          {
-            let const ii = range_match (pattern.substr (i), string[m]);
-            if (ii)
+            continue;
+
+          case '?':
+            set.set ();
+            ++i;
+            break;
+
+          case '[':
+            if (let const end = parse_range (pattern, i + 1, set); end)
               {
-                i += ii;
-                ++m;
+                i = end;
+                break;
               }
-            else
-              return false;
-          }
-          break;
-
-        default:
-          {
-            if (pattern[i] == '\\')
+            [[fallthrough]];
+
+          default:
+            if (pattern[i] == '\\' && i + 1 < pattern.size ())
               ++i;
-            if (string[m] != pattern[i])
-              return false;
+            set.reset ();
+            set.set (static_cast<unsigned char> (pattern[i]));
             ++i;
-            ++m;
-          }
-          break;
+            break;
+        }
+      M_enter.push_back (set);
+      M_is_start.push_back (false);
+      M_is_loop.push_back (false);
+      M_is_accept.push_back (false);
+    }
+  M_is_accept.back () = true;
+
+  let const length = M_enter.size () - first_state - 1;
+  M_min_length = std::min (M_min_length, length);
+  if (length == 0 || M_is_loop[first_state])
+    M_first.set ();
+  else
+    M_first |= M_enter[first_state + 1];
+  if (length == 0 || M_is_loop.back ())
+    M_last.set ();
+  else
+    M_last |= M_enter.back ();
+
+  build ();
+}
+
+def PatternSet::build () -> void
+{
+  let const states = M_enter.size ();
+  M_words = (states + S_word_bits - 1) / S_word_bits;
+  M_step.assign (256 * M_words, 0);
+  M_start.assign (M_words, 0);
+  M_loop.assign (M_words, 0);
+  M_accept.assign (M_words, 0);
+
+  for (std::size_t s = 0; s < states; ++s)
+    {
+      let const word = s / S_word_bits;
+      let const bit = Word (1) << (s % S_word_bits);
+      if (M_is_start[s])
+        M_start[word] |= bit;
+      if (M_is_loop[s])
+        M_loop[word] |= bit;
+      if (M_is_accept[s])
+        M_accept[word] |= bit;
+      for (let c = 0; c < 256; ++c)
+        {
+          if (M_enter[s][c])
+            M_step[c * M_words + word] |= bit;
+        }
+    }
+}
+
+def PatternSet::matches (std::string_view string) const -> bool
+{
+  if (string.size () < M_min_length)
+    return false;
+  if (!string.empty ()
+      && (!M_first[static_cast<unsigned char> (string.front ())]
+          || !M_last[static_cast<unsigned char> (string.back ())]))
+    return false;
+
+  // Sets with many states use a buffer per thread, the pool workers match
+  // names too.  It only grows on the first name after the set did.
+  Word small[8];
+  static thread_local std::vector<Word> S_large;
+  if (M_words > std::size (small) && S_large.size () < M_words)
+    S_large.resize (M_words);
+  let const states = M_words <= std::size (small) ? small : S_large.data ();
+  std::copy (M_start.begin (), M_start.end (), states);
+
+  for (let const c : string)
+    {
+      let const step = M_step.data () + static_cast<unsigned char> (c) * M_words;
+      // Every state advances to the next one if the byte fits it; states with
+      // a loop also stay where they are.  Start states are never entered so
+      // nothing carries over from one pattern into the next.
+      let carry = Word (0);
+      let any = Word (0);
+      for (std::size_t w = 0; w < M_words; ++w)
+        {
+          let const s = states[w];
+          states[w] = (((s << 1) | carry) & step[w]) | (s & M_loop[w]);
+          carry = s >> (S_word_bits - 1);
+          any |= states[w];
         }
+      if (!any)
+        return false;
+    }
+
+  for (std::size_t w = 0; w < M_words; ++w)
+    {
+      if (states[w] & M_accept[w])
+        return true;
     }
-  return m == string.size ();
+  return false;
 }
@@ -1,4 +1,48 @@
 #pragma once
 #include "stdafx.hh"
 
-def match (std::string_view pattern, std::string_view string) -> bool;
+// A set of shell patterns (`*`, `?`, `[...]` and `\` escapes) compiled into a
+// single automaton.  Every pattern becomes a chain of NFA states, one per
+// character it consumes, with a `*` turning into a loop on the state before
+// it.  The states of all patterns are simulated together as a bit vector, so
+// a string is read once no matter how many patterns there are and without
+// any backtracking.
+class PatternSet
+{
+public:
+  def add (std::string_view pattern) -> void;
+
+  def empty () const -> bool { return M_patterns == 0; }
+
+  // Whether `string` matches any of the patterns
+  def matches (std::string_view string) const -> bool;
+
+private:
+  using Word = std::uint64_t;
+  static constexpr std::size_t S_word_bits = 64;
+
+  // Rebuilds the word tables from the per-state data
+  def build () -> void;
+
+private:
+  std::size_t M_patterns {0};
+  // Per state: the bytes that lead into it, and whether it is a start state,
+  // has a `*` loop or is accepting.
+  arena::vector<std::bitset<256>> M_enter;
+  arena::vector<bool> M_is_start;
+  arena::vector<bool> M_is_loop;
+  arena::vector<bool> M_is_accept;
+
+  std::size_t M_words {0};
+  // M_step[byte * M_words + word]: the states that can be entered by reading
+  // `byte`
+  arena::vector<Word> M_step;
+  arena::vector<Word> M_start;
+  arena::vector<Word> M_loop;
+  arena::vector<Word> M_accept;
+
+  // Cheap rejects checked before running the automaton
+  std::bitset<256> M_first;
+  std::bitset<256> M_last;
+  std::size_t M_min_length {SIZE_MAX};
+};
@@ -54,10 +54,11 @@ def natural_compare (std::string_view a, std::string_view b) -> int
   // Compare first digit part
   a.remove_prefix (a_pos);
   b.remove_prefix (b_pos);
-  if ((c = (std::strtoull (a.data (), &a_end, 10)
-            - std::strtoull (b.data (), &b_end, 10)))
-      != 0)
-    return c;
+  // Compared instead of subtracted, the difference would not fit the result
+  let const a_number = std::strtoull (a.data (), &a_end, 10);
+  let const b_number = std::strtoull (b.data (), &b_end, 10);
+  if (a_number != b_number)
+    return a_number < b_number ? -1 : 1;
   // Recurse if either string has characters left
   a.remove_prefix (a_end - a.data ());
   b.remove_prefix (b_end - b.data ());
@@ -65,3 +66,63 @@ def natural_compare (std::string_view a, std::string_view b) -> int
     return natural_compare (a, b);
   return 0;
 }
+
+def natural_split (std::string_view str, arena::vector<NaturalSegment> &out) -> void
+{
+  let constexpr digits = "0123456789"sv;
+  while (!str.empty ())
+    {
+      let const pos = str.find_first_of (digits);
+      if (pos == std::string_view::npos)
+        {
+          out.push_back ({str, 0, false});
+          return;
+        }
+      let const text = str.substr (0, pos);
+      str.remove_prefix (pos);
+      // Same as strtoull, including saturating on overflow
+      let number = 0ULL;
+      let i = std::size_t (0);
+      for (; i < str.size () && str[i] >= '0' && str[i] <= '9'; ++i)
+        {
+          let const d = static_cast<unsigned> (str[i] - '0');
+          if (number > (ULLONG_MAX - d) / 10)
+            number = ULLONG_MAX;
+          else
+            number = number * 10 + d;
+        }
+      out.push_back ({text, number, true});
+      str.remove_prefix (i);
+    }
+}
+
+def natural_compare (std::span<const NaturalSegment> a,
+                     std::span<const NaturalSegment> b) -> int
+{
+  int c;
+  for (std::size_t i = 0; ; ++i)
+    {
+      let const a_empty = i == a.size ();
+      let const b_empty = i == b.size ();
+      if (a_empty && b_empty)
+        return 0;
+      // Prioritize empty strings
+      if ((c = b_empty - a_empty) != 0)
+        return c;
+      let const &as = a[i];
+      let const &bs = b[i];
+      // Prioritize strings starting with '.' to group dotfiles first
+      if ((c = ((!bs.text.empty () && bs.text.front () == '.')
+                - (!as.text.empty () && as.text.front () == '.')))
+          != 0)
+        return c;
+      if ((c = compare_non_digit (as.text, bs.text)) != 0)
+        return c;
+      if (!as.has_number)
+        return -1;
+      if (!bs.has_number)
+        return 1;
+      if (as.number != bs.number)
+        return as.number < bs.number ? -1 : 1;
+    }
+}
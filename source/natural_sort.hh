@@ -4,6 +4,24 @@
 
 def natural_compare (std::string_view a, std::string_view b) -> int;
 
+// One step of the natural comparison: a run of non-digits followed by the
+// number after it, if any.
+struct NaturalSegment
+{
+  std::string_view text;
+  unsigned long long number;
+  bool has_number;
+};
+
+// Splits `str` into the segments natural_compare looks at, so names that get
+// compared many times only need to be parsed once.  The segments refer to
+// `str`.
+def natural_split (std::string_view str, arena::vector<NaturalSegment> &out) -> void;
+
+// Same as natural_compare on the strings the segments were made from.
+def natural_compare (std::span<const NaturalSegment> a,
+                     std::span<const NaturalSegment> b) -> int;
+
 static inline def natural_compare (const fs::path &a, const fs::path &b) -> int
 {
   let const astr = unicode::path_to_str (a);
@@ -0,0 +1,75 @@
+#include "output.hh"
+#include "stats.hh"
+
+OutputBuffer G_out;
+
+def OutputBuffer::fill (char c, int count) -> void
+{
+  while (count > 0)
+    {
+      if (M_size == S_capacity)
+        flush ();
+      let const n = std::min (static_cast<std::size_t> (count), S_capacity - M_size);
+      std::memset (M_buf + M_size, c, n);
+      M_size += n;
+      count -= static_cast<int> (n);
+    }
+}
+
+def OutputBuffer::number (std::uintmax_t n, int width) -> void
+{
+  char digits[20];
+  let p = std::end (digits);
+  do
+    {
+      *--p = static_cast<char> ('0' + n % 10);
+      n /= 10;
+    } while (n);
+  right ({p, static_cast<std::size_t> (std::end (digits) - p)}, width);
+}
+
+def OutputBuffer::format (const char *fmt, ...) -> int
+{
+  std::va_list args;
+  va_start (args, fmt);
+  let n = std::vsnprintf (M_buf + M_size, S_capacity - M_size, fmt, args);
+  va_end (args);
+  if (n < 0)
+    return n;
+  if (static_cast<std::size_t> (n) < S_capacity - M_size)
+    {
+      M_size += n;
+      return n;
+    }
+  // Did not fit, format again into a buffer of the right size
+  arena::string buf (n, '\0');
+  va_start (args, fmt);
+  std::vsnprintf (buf.data (), buf.size () + 1, fmt, args);
+  va_end (args);
+  put (buf);
+  return n;
+}
+
+def OutputBuffer::write (const char *data, std::size_t size) -> void
+{
+  stats::Timer timer (stats::output);
+  stats::add (stats::bytes_written, size);
+#ifdef _WIN32
+  std::fwrite (data, 1, size, stdout);
+  std::fflush (stdout);
+#else
+  while (size)
+    {
+      let const n = ::write (STDOUT_FILENO, data, size);
+      if (n == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          // Nowhere to report this to; drop the output like stdio would
+          return;
+        }
+      data += n;
+      size -= n;
+    }
+#endif
+}
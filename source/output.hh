@@ -0,0 +1,70 @@
+#pragma once
+#include "stdafx.hh"
+
+// Buffer for everything written to stdout.  Listings are rendered into it
+// piece by piece and it is written out with a few large write calls instead
+// of going through stdio for every field.
+class OutputBuffer
+{
+public:
+  OutputBuffer () = default;
+
+  OutputBuffer (const OutputBuffer &) = delete;
+
+  ~OutputBuffer () { flush (); }
+
+  def put (char c) -> void
+  {
+    if (M_size == S_capacity)
+      flush ();
+    M_buf[M_size++] = c;
+  }
+
+  def put (std::string_view str) -> void
+  {
+    if (str.size () > S_capacity - M_size)
+      {
+        flush ();
+        if (str.size () > S_capacity)
+          {
+            write (str.data (), str.size ());
+            return;
+          }
+      }
+    std::memcpy (M_buf + M_size, str.data (), str.size ());
+    M_size += str.size ();
+  }
+
+  // Writes `count` copies of `c`, nothing if `count` is not positive
+  def fill (char c, int count) -> void;
+
+  // Like printf ("%*s", width, str); the width is in bytes.
+  def right (std::string_view str, int width) -> void
+  {
+    fill (' ', width - static_cast<int> (str.size ()));
+    put (str);
+  }
+
+  // Like printf ("%*ju", width, n)
+  def number (std::uintmax_t n, int width = 0) -> void;
+
+  // printf into the buffer, for the rare cases the functions above do not
+  // cover.  Returns the number of bytes written.
+  [[gnu::format (printf, 2, 3)]]
+  def format (const char *fmt, ...) -> int;
+
+  def flush () -> void
+  {
+    write (M_buf, M_size);
+    M_size = 0;
+  }
+
+private:
+  def write (const char *data, std::size_t size) -> void;
+
+  static constexpr std::size_t S_capacity = 64 * 1024;
+  char M_buf[S_capacity];
+  std::size_t M_size {0};
+};
+
+extern OutputBuffer G_out;
@@ -0,0 +1,277 @@
+#include "owners.hh"
+#include "stats.hh"
+
+#ifndef _WIN32
+
+namespace owners
+{
+
+// Open addressing hash map from ids to names
+class IdMap
+{
+public:
+  def find (std::uint32_t id) const -> const std::string_view *
+  {
+    if (M_slots.empty ())
+      return nullptr;
+    for (let i = slot_of (id); ; i = (i + 1) & (M_slots.size () - 1))
+      {
+        let const &slot = M_slots[i];
+        if (!slot.used)
+          return nullptr;
+        if (slot.id == id)
+          return &slot.name;
+      }
+  }
+
+  // Does nothing if `id` is already in the map
+  def insert (std::uint32_t id, std::string_view name) -> void
+  {
+    if ((M_size + 1) * 2 > M_slots.size ())
+      grow ();
+    for (let i = slot_of (id); ; i = (i + 1) & (M_slots.size () - 1))
+      {
+        let &slot = M_slots[i];
+        if (slot.used && slot.id == id)
+          return;
+        if (!slot.used)
+          {
+            slot = {id, true, name};
+            ++M_size;
+            return;
+          }
+      }
+  }
+
+private:
+  struct Slot
+  {
+    std::uint32_t id;
+    bool used;
+    std::string_view name;
+  };
+
+  def slot_of (std::uint32_t id) const -> std::size_t
+  {
+    // Fibonacci hashing, ids tend to be clustered
+    return ((id * std::uint64_t (0x9e3779b97f4a7c15)) >> 32) & (M_slots.size () - 1);
+  }
+
+  def grow () -> void
+  {
+    arena::vector<Slot> old (std::max (M_slots.size () * 2, std::size_t (64)));
+    old.swap (M_slots);
+    M_size = 0;
+    for (let const &slot : old)
+      {
+        if (slot.used)
+          insert (slot.id, slot.name);
+      }
+  }
+
+  arena::vector<Slot> M_slots;
+  std::size_t M_size {0};
+};
+
+// Where all names live; a deque never moves its elements.
+static std::deque<arena::string> S_names;
+
+static IdMap S_users;
+static IdMap S_groups;
+
+static def intern (std::string_view name) -> std::string_view
+{
+  return S_names.emplace_back (name);
+}
+
+// Whether the database is looked up in the local files first
+static def files_first (std::string_view database) -> bool
+{
+  std::FILE *f = std::fopen ("/etc/nsswitch.conf", "r");
+  if (!f)
+    return false;
+  char line[512];
+  let result = false;
+  while (std::fgets (line, sizeof (line), f))
+    {
+      let l = std::string_view (line);
+      if (!l.starts_with (database) || l.size () == database.size ()
+          || l[database.size ()] != ':')
+        continue;
+      l.remove_prefix (database.size () + 1);
+      let const begin = l.find_first_not_of (" \t");
+      if (begin != std::string_view::npos)
+        {
+          l.remove_prefix (begin);
+          let const end = l.find_first_of (" \t\n");
+          result = l.substr (0, end) == "files"sv;
+        }
+      break;
+    }
+  std::fclose (f);
+  return result;
+}
+
+// Adds the names from /etc/passwd or /etc/group, whose lines both start
+// with "name:password:id:".
+static def read_database (const char *path, IdMap &map) -> void
+{
+  std::FILE *f = std::fopen (path, "r");
+  if (!f)
+    return;
+  char line[4096];
+  while (std::fgets (line, sizeof (line), f))
+    {
+      let const l = std::string_view (line);
+      let const name_end = l.find (':');
+      if (name_end == std::string_view::npos || name_end == 0)
+        continue;
+      let const id_begin = l.find (':', name_end + 1);
+      if (id_begin == std::string_view::npos)
+        continue;
+      char *id_end;
+      let const id = std::strtoul (line + id_begin + 1, &id_end, 10);
+      if (*id_end != ':' || id_end == line + id_begin + 1)
+        continue;
+      // The first entry wins, like for getpwuid
+      if (!map.find (id))
+        map.insert (id, intern (l.substr (0, name_end)));
+    }
+  std::fclose (f);
+}
+
+// Looks up `ids` with `lookup` (which must be thread-safe) on several
+// threads and adds the results to `map`.
+template <class Id, class Lookup>
+static def lookup_concurrently (const arena::vector<Id> &ids, IdMap &map,
+                                Lookup lookup) -> void
+{
+  if (ids.empty ())
+    return;
+  // The threads only use the standard allocator
+  std::vector<std::optional<std::string>> names (ids.size ());
+  let const thread_count = std::min (ids.size (), std::size_t (16));
+  if (thread_count == 1)
+    names[0] = lookup (ids[0]);
+  else
+    {
+      std::vector<std::thread> threads;
+      threads.reserve (thread_count);
+      for (std::size_t t = 0; t < thread_count; ++t)
+        threads.emplace_back ([&, t]() {
+          for (let i = t; i < ids.size (); i += thread_count)
+            names[i] = lookup (ids[i]);
+        });
+      for (let &thread : threads)
+        thread.join ();
+    }
+
+  for (std::size_t i = 0; i < ids.size (); ++i)
+    {
+      if (names[i])
+        map.insert (ids[i], intern (*names[i]));
+      else
+        map.insert (ids[i], intern (std::to_string (ids[i])));
+    }
+}
+
+static def getpw_buffer_size () -> std::size_t
+{
+  let const size = sysconf (_SC_GETPW_R_SIZE_MAX);
+  return size > 0 ? static_cast<std::size_t> (size) : 1024;
+}
+
+static def lookup_user (uid_t uid) -> std::optional<std::string>
+{
+  stats::add (stats::nss_lookups);
+  std::vector<char> buf (getpw_buffer_size ());
+  struct passwd pw, *result;
+  int err;
+  while ((err = getpwuid_r (uid, &pw, buf.data (), buf.size (), &result)) == ERANGE)
+    buf.resize (buf.size () * 2);
+  if (err || !result)
+    return std::nullopt;
+  return std::string (result->pw_name);
+}
+
+static def lookup_group (gid_t gid) -> std::optional<std::string>
+{
+  stats::add (stats::nss_lookups);
+  std::vector<char> buf (getpw_buffer_size ());
+  struct group gr, *result;
+  int err;
+  while ((err = getgrgid_r (gid, &gr, buf.data (), buf.size (), &result)) == ERANGE)
+    buf.resize (buf.size () * 2);
+  if (err || !result)
+    return std::nullopt;
+  return std::string (result->gr_name);
+}
+
+def resolve (std::span<const uid_t> uids, std::span<const gid_t> gids) -> void
+{
+  static let S_read_passwd = false;
+  static let S_read_group = false;
+
+  let const missing = [](auto ids, IdMap &map) {
+    arena::vector<std::remove_cvref_t<decltype (ids[0])>> out;
+    for (let const id : ids)
+      {
+        if (!map.find (id))
+          out.push_back (id);
+      }
+    std::sort (out.begin (), out.end ());
+    out.erase (std::unique (out.begin (), out.end ()), out.end ());
+    return out;
+  };
+
+  let missing_uids = missing (uids, S_users);
+  if (!missing_uids.empty () && !S_read_passwd)
+    {
+      S_read_passwd = true;
+      if (files_first ("passwd"sv))
+        {
+          read_database ("/etc/passwd", S_users);
+          missing_uids = missing (std::span<const uid_t> (missing_uids), S_users);
+        }
+    }
+
+  let missing_gids = missing (gids, S_groups);
+  if (!missing_gids.empty () && !S_read_group)
+    {
+      S_read_group = true;
+      if (files_first ("group"sv))
+        {
+          read_database ("/etc/group", S_groups);
+          missing_gids = missing (std::span<const gid_t> (missing_gids), S_groups);
+        }
+    }
+
+  lookup_concurrently (missing_uids, S_users, lookup_user);
+  lookup_concurrently (missing_gids, S_groups, lookup_group);
+}
+
+def user_name (uid_t uid) -> std::string_view
+{
+  if (let const name = S_users.find (uid))
+    {
+      stats::add (stats::owner_cache_hits);
+      return *name;
+    }
+  resolve ({&uid, 1}, {});
+  return *S_users.find (uid);
+}
+
+def group_name (gid_t gid) -> std::string_view
+{
+  if (let const name = S_groups.find (gid))
+    {
+      stats::add (stats::owner_cache_hits);
+      return *name;
+    }
+  resolve ({}, {&gid, 1});
+  return *S_groups.find (gid);
+}
+
+}
+
+#endif // !_WIN32
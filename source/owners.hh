@@ -0,0 +1,23 @@
+#pragma once
+#include "stdafx.hh"
+
+#ifndef _WIN32
+
+// Cached user and group names.  Names are interned, the returned views stay
+// valid until the program exits.  Ids that have no name are shown as numbers.
+namespace owners
+{
+
+def user_name (uid_t uid) -> std::string_view;
+
+def group_name (gid_t gid) -> std::string_view;
+
+// Looks up all of the ids that are not cached yet at once.  If nsswitch.conf
+// lists `files` first, /etc/passwd and /etc/group are read directly; the ids
+// not found there are looked up with concurrent getpwuid_r/getgrgid_r calls
+// so slow sources like LDAP cost one round-trip instead of one per id.
+def resolve (std::span<const uid_t> uids, std::span<const gid_t> gids) -> void;
+
+}
+
+#endif // !_WIN32
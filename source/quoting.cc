@@ -0,0 +1,101 @@
+#include "quoting.hh"
+
+namespace quoting
+{
+
+namespace
+{
+
+struct Table
+{
+  std::uint8_t classes[256];
+};
+
+constexpr def make_table () -> Table
+{
+  Table t {};
+  // Source: https://www.opencoverage.net/coreutils/index_html/source_213.html
+  for (let const c : " !$&()*;<=>[^`|"sv)
+    t.classes[static_cast<unsigned char> (c)] = special;
+  t.classes['\''] = single_quote;
+  t.classes['"'] = double_quote;
+  for (let c = 0; c < 0x20; ++c)
+    t.classes[c] = control;
+  t.classes[0x7f] = control;
+  return t;
+}
+
+constexpr Table S_table = make_table ();
+
+}
+
+const std::uint8_t *const byte_classes = S_table.classes;
+
+// The vector loops only look for bytes that may have a class: everything up
+// to '*', ";<=>", '[', '^', '`', '|' and DEL.  The few hits ('#', '%' and the
+// classified bytes) are then looked up in the table.
+def classify (std::string_view str) -> unsigned
+{
+  let p = reinterpret_cast<const unsigned char *> (str.data ());
+  let const end = p + str.size ();
+  let classes = 0u;
+  let const lookup = [&classes](const unsigned char *block, unsigned mask) {
+    for (; mask; mask &= mask - 1)
+      classes |= S_table.classes[block[std::countr_zero (mask)]];
+  };
+#ifdef __AVX2__
+  {
+    let const low = _mm256_set1_epi8 (0x2a);
+    let const range_begin = _mm256_set1_epi8 (0x3b);
+    let const range_size = _mm256_set1_epi8 (3);
+    let const bracket = _mm256_set1_epi8 ('[');
+    let const caret = _mm256_set1_epi8 ('^');
+    let const backtick = _mm256_set1_epi8 ('`');
+    let const pipe = _mm256_set1_epi8 ('|');
+    let const del = _mm256_set1_epi8 (0x7f);
+    for (; end - p >= 32; p += 32)
+      {
+        let const v = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (p));
+        let const r = _mm256_sub_epi8 (v, range_begin);
+        let hits = _mm256_cmpeq_epi8 (_mm256_min_epu8 (v, low), v);
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (_mm256_min_epu8 (r, range_size), r));
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (v, bracket));
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (v, caret));
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (v, backtick));
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (v, pipe));
+        hits = _mm256_or_si256 (hits, _mm256_cmpeq_epi8 (v, del));
+        lookup (p, static_cast<unsigned> (_mm256_movemask_epi8 (hits)));
+      }
+  }
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+  {
+    let const low = _mm_set1_epi8 (0x2a);
+    let const range_begin = _mm_set1_epi8 (0x3b);
+    let const range_size = _mm_set1_epi8 (3);
+    let const bracket = _mm_set1_epi8 ('[');
+    let const caret = _mm_set1_epi8 ('^');
+    let const backtick = _mm_set1_epi8 ('`');
+    let const pipe = _mm_set1_epi8 ('|');
+    let const del = _mm_set1_epi8 (0x7f);
+    for (; end - p >= 16; p += 16)
+      {
+        let const v = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p));
+        let const r = _mm_sub_epi8 (v, range_begin);
+        let hits = _mm_cmpeq_epi8 (_mm_min_epu8 (v, low), v);
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (_mm_min_epu8 (r, range_size), r));
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (v, bracket));
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (v, caret));
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (v, backtick));
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (v, pipe));
+        hits = _mm_or_si128 (hits, _mm_cmpeq_epi8 (v, del));
+        lookup (p, static_cast<unsigned> (_mm_movemask_epi8 (hits)));
+      }
+  }
+#endif
+  for (; p != end; ++p)
+    classes |= S_table.classes[*p];
+  return classes;
+}
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "stdafx.hh"
+
+// Classification of the bytes in file names that affect quoting and
+// escaping.  Only ASCII bytes ever need to be changed, so bytes of multibyte
+// UTF-8 sequences can be copied through without decoding them.
+namespace quoting
+{
+
+enum ByteClass : unsigned
+{
+  single_quote = 1,
+  double_quote = 2,
+  // Makes the shell treat the name specially, so it needs to be quoted
+  special = 4,
+  // Not printable, shown according to --nongraphic
+  control = 8,
+};
+
+// ByteClass bits of every byte value
+extern const std::uint8_t *const byte_classes;
+
+inline def byte_class (char c) -> unsigned
+{
+  return byte_classes[static_cast<unsigned char> (c)];
+}
+
+// Bitwise or of the classes of all bytes in `str`
+def classify (std::string_view str) -> unsigned;
+
+}
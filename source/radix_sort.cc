@@ -0,0 +1,110 @@
+#include "radix_sort.hh"
+
+namespace radix
+{
+
+def sort (arena::vector<Item> &items) -> void
+{
+  let const n = items.size ();
+  if (n < 2)
+    return;
+
+  // Histograms for all 8 bytes in a single pass
+  std::size_t counts[8][256] = {};
+  for (let const &item : items)
+    {
+      for (let b = 0; b < 8; ++b)
+        ++counts[b][(item.key >> (b * 8)) & 0xff];
+    }
+
+  arena::vector<Item> buffer (n);
+  let from = &items;
+  let to = &buffer;
+
+  for (let b = 0; b < 8; ++b)
+    {
+      let const &count = counts[b];
+      let const shift = b * 8;
+      // All keys have the same byte here
+      if (count[(items.front ().key >> shift) & 0xff] == n)
+        continue;
+
+      std::size_t offsets[256];
+      let sum = std::size_t (0);
+      for (let i = 0; i < 256; ++i)
+        {
+          offsets[i] = sum;
+          sum += count[i];
+        }
+
+      let const src = from->data ();
+      let const dst = to->data ();
+      for (std::size_t i = 0; i < n; ++i)
+        dst[offsets[(src[i].key >> shift) & 0xff]++] = src[i];
+
+      std::swap (from, to);
+    }
+
+  if (from != &items)
+    items.swap (buffer);
+}
+
+def prefix_key (std::string_view str) -> std::uint64_t
+{
+  let key = std::uint64_t (0);
+  let const l = std::min (str.size (), std::size_t (8));
+  for (std::size_t i = 0; i < l; ++i)
+    key |= std::uint64_t (static_cast<unsigned char> (str[i])) << (56 - i * 8);
+  return key;
+}
+
+def sort_strings (arena::vector<std::uint32_t> &order,
+                  const arena::vector<std::string_view> &strings,
+                  bool descending) -> void
+{
+  let const n = order.size ();
+  arena::vector<Item> items;
+  items.reserve (n);
+  for (let const i : order)
+    {
+      let const key = prefix_key (strings[i]);
+      items.push_back ({descending ? ~key : key, i});
+    }
+
+  sort (items);
+
+  for (std::size_t i = 0; i < n; ++i)
+    order[i] = items[i].index;
+
+  // Strings that share their first 8 bytes (or are shorter and equal) still
+  // need to be compared.
+  let const compare = [&strings, descending](std::uint32_t a, std::uint32_t b) {
+    let const c = strings[a].compare (strings[b]);
+    return descending ? c > 0 : c < 0;
+  };
+  for (std::size_t begin = 0, end; begin < n; begin = end)
+    {
+      end = begin + 1;
+      while (end < n && items[end].key == items[begin].key)
+        ++end;
+      if (end - begin > 1)
+        std::stable_sort (order.begin () + begin, order.begin () + end, compare);
+    }
+}
+
+def sort_by_key (arena::vector<std::uint32_t> &order,
+                 const arena::vector<std::uint64_t> &keys) -> void
+{
+  let const n = order.size ();
+  arena::vector<Item> items;
+  items.reserve (n);
+  for (let const i : order)
+    items.push_back ({keys[i], i});
+
+  sort (items);
+
+  for (std::size_t i = 0; i < n; ++i)
+    order[i] = items[i].index;
+}
+
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "stdafx.hh"
+
+namespace radix
+{
+
+struct Item
+{
+  std::uint64_t key;
+  std::uint32_t index;
+};
+
+// Stable LSD radix sort by `key`, ascending.  Byte positions where all keys
+// are equal are skipped, so small sizes or a narrow range of times only cost
+// a few passes.
+def sort (arena::vector<Item> &items) -> void;
+
+// The first 8 bytes of `str` in big endian order, so comparing the results
+// orders the strings by their prefix.  Shorter strings are padded with zeros.
+def prefix_key (std::string_view str) -> std::uint64_t;
+
+// Stable sort of `order` (indices into `strings`) by the strings: a radix
+// sort on the 8 byte prefixes, then a comparison sort of the runs that share
+// a prefix.
+def sort_strings (arena::vector<std::uint32_t> &order,
+                  const arena::vector<std::string_view> &strings,
+                  bool descending) -> void;
+
+// Stable sort of `order` by `keys[index]`.
+def sort_by_key (arena::vector<std::uint32_t> &order,
+                 const arena::vector<std::uint64_t> &keys) -> void;
+
+}
@@ -0,0 +1,569 @@
+#include "server.hh"
+#include "client.hh"
+#include "output.hh"
+#include "args.hh"
+#include "stats.hh"
+
+#ifdef __linux__
+
+namespace server
+{
+
+// Events that make the kept contents of a directory outdated
+static constexpr std::uint32_t S_watch_mask = (IN_ATTRIB | IN_CREATE | IN_DELETE
+                                               | IN_DELETE_SELF | IN_MODIFY
+                                               | IN_MOVE_SELF | IN_MOVED_FROM
+                                               | IN_MOVED_TO | IN_ONLYDIR);
+
+static int S_inotify_fd = -1;
+
+// Limits of what is kept; the oldest directories are dropped first.  The
+// watches stay well below the usual max_user_watches of 8192 or more, so
+// children can still add theirs.
+static constexpr std::size_t S_max_kept_bytes = 256 << 20;
+static constexpr std::size_t S_max_watches = 4096;
+
+// Kept directory contents, made by cache::serialize
+struct Kept
+{
+  int wd;
+  std::string data;
+  // Key in S_kept_order
+  std::uint64_t stored;
+};
+
+static std::map<cache::Identity, Kept> S_kept;
+static std::map<int, std::vector<cache::Identity>> S_kept_by_watch;
+// Kept directories by when they were stored
+static std::map<std::uint64_t, cache::Identity> S_kept_order;
+static std::uint64_t S_stored = 0;
+static std::size_t S_kept_bytes = 0;
+// Counts changes to what is kept, so a spare worker knows whether its copy
+// is still current
+static std::uint64_t S_kept_changes = 0;
+
+// Events are numbered so reports can be checked against the events that
+// happened since the child that made them was given its request.
+static std::uint64_t S_events = 0;
+static std::map<int, std::uint64_t> S_last_event;
+static std::uint64_t S_last_overflow = 0;
+
+// A child running a request
+struct Child
+{
+  int report_fd;
+  // S_events when it was given the request
+  std::uint64_t started_at;
+};
+
+static std::vector<Child> S_children;
+
+// The worker forked ahead of the next request, so the request does not wait
+// for the fork, and S_kept_changes at the time.  -1 if there is none.
+static int S_spare_fd = -1;
+static std::uint64_t S_spare_kept_changes = 0;
+
+// In a child, the socket to send reports on
+static bool S_in_request = false;
+static int S_report_fd = -1;
+static std::mutex S_report_mutex;
+// In a child, the client's connection until it is answered
+static int S_request_conn = -1;
+
+
+// Removes a watch.  Reports using it are rejected like after an event,
+// since the directory is no longer watched for changes.
+static def release_watch (int wd) -> void
+{
+  inotify_rm_watch (S_inotify_fd, wd);
+  S_last_event[wd] = ++S_events;
+}
+
+
+static def erase_kept (std::map<cache::Identity, Kept>::iterator it) -> void
+{
+  S_kept_bytes -= it->second.data.size ();
+  S_kept_order.erase (it->second.stored);
+  S_kept.erase (it);
+  ++S_kept_changes;
+}
+
+
+// Drops everything kept for a watch, and the watch itself
+static def drop_watch (int wd) -> void
+{
+  if (let const it = S_kept_by_watch.find (wd); it != S_kept_by_watch.end ())
+    {
+      for (let const &id : it->second)
+        if (let const kept = S_kept.find (id); kept != S_kept.end () && kept->second.wd == wd)
+          erase_kept (kept);
+      S_kept_by_watch.erase (it);
+    }
+  release_watch (wd);
+}
+
+
+// Drops one kept directory, and its watch if nothing else uses it
+static def forget (std::map<cache::Identity, Kept>::iterator it) -> void
+{
+  let const wd = it->second.wd;
+  let const id = it->first;
+  erase_kept (it);
+  let const by_watch = S_kept_by_watch.find (wd);
+  if (by_watch == S_kept_by_watch.end ())
+    return;
+  std::erase (by_watch->second, id);
+  if (by_watch->second.empty ())
+    {
+      S_kept_by_watch.erase (by_watch);
+      release_watch (wd);
+    }
+}
+
+
+// Reads all pending inotify events
+static def read_events () -> void
+{
+  alignas (inotify_event) char buf[64 * 1024];
+  for (;;)
+    {
+      let const n = read (S_inotify_fd, buf, sizeof (buf));
+      if (n <= 0)
+        return;
+      for (let p = buf; p < buf + n; )
+        {
+          let const &e = *reinterpret_cast<const inotify_event *> (p);
+          p += sizeof (inotify_event) + e.len;
+          ++S_events;
+          if (e.mask & IN_Q_OVERFLOW)
+            {
+              // Events were lost, so nothing kept can be trusted
+              S_last_overflow = S_events;
+              while (!S_kept_by_watch.empty ())
+                drop_watch (S_kept_by_watch.begin ()->first);
+            }
+          else
+            {
+              S_last_event[e.wd] = S_events;
+              // Watches nothing is kept for, like those of children that
+              // never reported, go away with their first event.
+              if (!(e.mask & IN_IGNORED))
+                drop_watch (e.wd);
+            }
+        }
+    }
+}
+
+
+// Event numbers older than every child are not needed any more
+static def prune_events () -> void
+{
+  let oldest = S_events;
+  for (let const &c : S_children)
+    oldest = std::min (oldest, c.started_at);
+  std::erase_if (S_last_event, [oldest](const auto &e) {
+    return e.second <= oldest;
+  });
+}
+
+
+// Answers the request of a worker with the exit status of the listing
+static def answer (int status) -> void
+{
+  if (S_request_conn == -1)
+    return;
+  G_out.flush ();
+  std::fflush (stdout);
+  client::send_all (S_request_conn, &status, sizeof (status));
+  S_request_conn = -1;
+}
+
+
+// Runs the request of the connection `conn`, as described in client.hh, in
+// a worker and exits.
+[[noreturn]] static def run_request (int conn, int (*run) (int, const char **)) -> void
+{
+  // A client that never sends its request does not keep the worker
+  timeval timeout { 5, 0 };
+  setsockopt (conn, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+  std::uint32_t length;
+  int fds[3];
+  iovec iov { &length, sizeof (length) };
+  alignas (cmsghdr) char control[CMSG_SPACE (sizeof (fds))];
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+  let const n = recvmsg (conn, &msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+  let const cmsg = CMSG_FIRSTHDR (&msg);
+  if (n != sizeof (length) || !cmsg || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN (sizeof (fds)))
+    _exit (2);
+  std::memcpy (fds, CMSG_DATA (cmsg), sizeof (fds));
+
+  std::string strings (length, '\0');
+  if (length == 0 || !client::read_all (conn, strings.data (), length)
+      || std::count (strings.begin (), strings.end (), '\0') < 2
+      || strings.back () != '\0')
+    _exit (2);
+
+  dup2 (fds[0], STDOUT_FILENO);
+  dup2 (fds[1], STDERR_FILENO);
+  let const cwd_error = fchdir (fds[2]) == 0 ? 0 : errno;
+  for (let const fd : fds)
+    close (fd);
+
+  std::vector<const char *> argv;
+  for (std::size_t i = 0; i < strings.size (); i = strings.find ('\0', i) + 1)
+    argv.push_back (strings.data () + i);
+  if (argv[0][0] == '=')
+    setenv ("TZ", argv[0] + 1, 1);
+  else
+    unsetenv ("TZ");
+  tzset ();
+  argv.erase (argv.begin ());
+  argv.push_back (nullptr);
+  stats::restart ();
+  // Exits from within the listing, like for --help, are answered too
+  S_request_conn = conn;
+  std::atexit ([]() { answer (0); });
+
+  int status = 2;
+  if (cwd_error)
+    std::fprintf (stderr, "%s: cannot change to the working directory: %s\n",
+                  argv[0], std::strerror (cwd_error));
+  else
+    status = run (static_cast<int> (argv.size () - 1), argv.data ());
+  answer (status);
+  // Without the destructors, which would free a copy of everything kept
+  _exit (status);
+}
+
+
+// Passes the connection `conn` to a worker over its socket `fd`
+static def send_connection (int fd, int conn) -> bool
+{
+  char byte = 0;
+  iovec iov { &byte, sizeof (byte) };
+  alignas (cmsghdr) char control[CMSG_SPACE (sizeof (conn))] = {};
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+  let const cmsg = CMSG_FIRSTHDR (&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN (sizeof (conn));
+  std::memcpy (CMSG_DATA (cmsg), &conn, sizeof (conn));
+  return sendmsg (fd, &msg, MSG_NOSIGNAL) == sizeof (byte);
+}
+
+
+// Waits for the connection of send_connection, -1 once the server closed
+// the socket.
+static def receive_connection (int fd) -> int
+{
+  char byte;
+  int conn;
+  iovec iov { &byte, sizeof (byte) };
+  alignas (cmsghdr) char control[CMSG_SPACE (sizeof (conn))];
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof (control);
+  ssize_t n;
+  do
+    n = recvmsg (fd, &msg, MSG_CMSG_CLOEXEC);
+  while (n == -1 && errno == EINTR);
+  let const cmsg = CMSG_FIRSTHDR (&msg);
+  if (n != sizeof (byte) || !cmsg || cmsg->cmsg_type != SCM_RIGHTS
+      || cmsg->cmsg_len != CMSG_LEN (sizeof (conn)))
+    return -1;
+  std::memcpy (&conn, CMSG_DATA (cmsg), sizeof (conn));
+  return conn;
+}
+
+
+// Forks a worker, which gets what is kept at this time.  It waits for a
+// connection on the returned socket, runs its request and reports on the
+// same socket.  Returns -1 on errors.
+static def fork_worker (int listen_fd, int (*run) (int, const char **)) -> int
+{
+  int report[2];
+  if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, report) == -1)
+    return -1;
+  let const pid = fork ();
+  if (pid == 0)
+    {
+      close (listen_fd);
+      close (report[0]);
+      for (let const &c : S_children)
+        close (c.report_fd);
+      S_children.clear ();
+      if (S_spare_fd != -1)
+        close (S_spare_fd);
+      S_in_request = true;
+      S_report_fd = report[1];
+      signal (SIGPIPE, SIG_DFL);
+      signal (SIGCHLD, SIG_DFL);
+
+      let const conn = receive_connection (report[1]);
+      // A spare that is not needed any more
+      if (conn == -1)
+        _exit (0);
+      run_request (conn, run);
+    }
+
+  close (report[1]);
+  if (pid == -1)
+    {
+      close (report[0]);
+      return -1;
+    }
+  return report[0];
+}
+
+
+// Forks a new spare worker if there is none or it missed changes to what is
+// kept.  This waits until no request is running, so the fork does not take
+// time from a listing and the spare gets everything the children report.
+static def refresh_spare (int listen_fd, int (*run) (int, const char **)) -> void
+{
+  if (!S_children.empty ()
+      || (S_spare_fd != -1 && S_spare_kept_changes == S_kept_changes))
+    return;
+  // It exits when it sees its socket closed
+  if (S_spare_fd != -1)
+    close (S_spare_fd);
+  S_spare_fd = fork_worker (listen_fd, run);
+  S_spare_kept_changes = S_kept_changes;
+}
+
+
+// Gives the connection `conn` to a worker: the spare if what it has is
+// still current, or a new one.
+static def start_request (int conn, int listen_fd,
+                          int (*run) (int, const char **)) -> void
+{
+  // Requests run with our credentials, so only our own user may make them
+  ucred peer;
+  socklen_t peer_size = sizeof (peer);
+  if (getsockopt (conn, SOL_SOCKET, SO_PEERCRED, &peer, &peer_size) == -1
+      || peer.uid != geteuid ())
+    {
+      close (conn);
+      return;
+    }
+
+  // Changes that happened before the request must not be missed by the
+  // worker that runs it
+  read_events ();
+  let fd = S_spare_fd;
+  S_spare_fd = -1;
+  if (fd != -1 && (S_spare_kept_changes != S_kept_changes
+                   || !send_connection (fd, conn)))
+    {
+      close (fd);
+      fd = -1;
+    }
+  if (fd == -1 && (fd = fork_worker (listen_fd, run)) != -1
+      && !send_connection (fd, conn))
+    {
+      close (fd);
+      fd = -1;
+    }
+  close (conn);
+  if (fd != -1)
+    S_children.push_back ({ fd, S_events });
+}
+
+
+// Reads a report of a child: the watch, the size of the data and the data.
+// Returns false when the child is done.
+static def read_report (const Child &child) -> bool
+{
+  int wd;
+  std::uint64_t size;
+  if (!client::read_all (child.report_fd, &wd, sizeof (wd))
+      || !client::read_all (child.report_fd, &size, sizeof (size)))
+    return false;
+  std::string data (size, '\0');
+  if (!client::read_all (child.report_fd, data.data (), size))
+    return false;
+
+  // Anything that happened in the directory after the child was given its
+  // request may or may not be in the data, so it is only kept if nothing did.
+  read_events ();
+  let const last_event = S_last_event.find (wd);
+  let const changed = (S_last_overflow > child.started_at
+                       || (last_event != S_last_event.end ()
+                           && last_event->second > child.started_at));
+  let const id = changed ? std::nullopt : cache::identity (data);
+  if (!id)
+    {
+      // Empty data only tells about the watch
+      if (!S_kept_by_watch.contains (wd))
+        release_watch (wd);
+      return true;
+    }
+
+  // A directory read again under the same watch keeps it
+  if (let const old = S_kept.find (*id); old != S_kept.end ())
+    {
+      if (old->second.wd == wd)
+        erase_kept (old);
+      else
+        forget (old);
+    }
+  S_kept_bytes += data.size ();
+  S_kept_order.emplace (S_stored, *id);
+  S_kept[*id] = { wd, std::move (data), S_stored++ };
+  let &ids = S_kept_by_watch[wd];
+  if (std::find (ids.begin (), ids.end (), *id) == ids.end ())
+    ids.push_back (*id);
+  ++S_kept_changes;
+
+  while (S_kept_bytes > S_max_kept_bytes
+         || S_kept_by_watch.size () > S_max_watches)
+    forget (S_kept.find (S_kept_order.begin ()->second));
+  return true;
+}
+
+
+def serve (const char *path, int (*run) (int, const char **)) -> int
+{
+  sockaddr_un addr;
+  if (!client::socket_address (path, addr))
+    {
+      std::fprintf (stderr, "%s: socket path too long: %s\n", G_program, path);
+      return 1;
+    }
+
+  let const listen_fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (listen_fd == -1)
+    {
+      std::fprintf (stderr, "%s: socket: %s\n", G_program, std::strerror (errno));
+      return 1;
+    }
+  // A socket left behind by a server that is gone is replaced
+  if (connect (listen_fd, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) == 0)
+    {
+      std::fprintf (stderr, "%s: a server is already running on %s\n",
+                    G_program, path);
+      return 1;
+    }
+  unlink (path);
+  // Created with mode 0600 so other users can not connect at all
+  let const old_umask = umask (0177);
+  let const bound = bind (listen_fd, reinterpret_cast<sockaddr *> (&addr),
+                          sizeof (addr)) == 0;
+  umask (old_umask);
+  if (!bound || listen (listen_fd, SOMAXCONN) == -1)
+    {
+      std::fprintf (stderr, "%s: %s: %s\n", G_program, path, std::strerror (errno));
+      return 1;
+    }
+
+  S_inotify_fd = inotify_init1 (IN_NONBLOCK);
+  if (S_inotify_fd == -1)
+    {
+      std::fprintf (stderr, "%s: inotify: %s\n", G_program, std::strerror (errno));
+      return 1;
+    }
+
+  // Children are not waited for, and a client going away must not end the
+  // server.
+  signal (SIGCHLD, SIG_IGN);
+  signal (SIGPIPE, SIG_IGN);
+  // Loads the NSS modules and the time zone once so children do not have to
+  getpwuid (getuid ());
+  getgrgid (getgid ());
+  tzset ();
+
+  std::vector<pollfd> fds;
+  for (;;)
+    {
+      refresh_spare (listen_fd, run);
+      fds.clear ();
+      fds.push_back ({ listen_fd, POLLIN, 0 });
+      fds.push_back ({ S_inotify_fd, POLLIN, 0 });
+      for (let const &c : S_children)
+        fds.push_back ({ c.report_fd, POLLIN, 0 });
+      if (poll (fds.data (), fds.size (), -1) == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          std::fprintf (stderr, "%s: poll: %s\n", G_program, std::strerror (errno));
+          return 1;
+        }
+
+      if (fds[1].revents)
+        read_events ();
+
+      // Reports before new requests, so their workers get them
+      for (std::size_t i = 2, c = 0; i < fds.size (); ++i)
+        {
+          if (fds[i].revents && !read_report (S_children[c]))
+            {
+              close (S_children[c].report_fd);
+              S_children.erase (S_children.begin () + c);
+            }
+          else
+            ++c;
+        }
+
+      if (fds[0].revents & POLLIN)
+        {
+          let const conn = accept4 (listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+          if (conn != -1)
+            start_request (conn, listen_fd, run);
+        }
+      prune_events ();
+    }
+}
+
+
+def in_request () -> bool
+{
+  return S_in_request;
+}
+
+
+def find (const cache::Identity &id) -> std::string_view
+{
+  let const it = S_kept.find (id);
+  return it == S_kept.end () ? std::string_view {} : it->second.data;
+}
+
+
+def watch (const fs::path &path) -> int
+{
+  return inotify_add_watch (S_inotify_fd, path.c_str (), S_watch_mask);
+}
+
+
+def report (int wd, std::string_view data) -> void
+{
+  if (wd == -1)
+    return;
+  let const size = static_cast<std::uint64_t> (data.size ());
+  std::lock_guard lock (S_report_mutex);
+  // Once the server is gone there is nobody to report to
+  if (S_report_fd == -1)
+    return;
+  if (!client::send_all (S_report_fd, &wd, sizeof (wd))
+      || !client::send_all (S_report_fd, &size, sizeof (size))
+      || !client::send_all (S_report_fd, data.data (), data.size ()))
+    {
+      close (S_report_fd);
+      S_report_fd = -1;
+    }
+}
+
+}
+
+#endif // __linux__
@@ -0,0 +1,45 @@
+#pragma once
+#include "stdafx.hh"
+#include "cache.hh"
+
+// The resident server of --serve.
+//
+// The server waits for requests of clients, see client.hh, on a Unix domain
+// socket.  Each request is run by a child process forked from the server, so
+// it starts from the same clean state as a new process and writes straight
+// to the client's output.  The child is forked ahead of the request while
+// the server is idle, so the request does not wait for the fork.  The server
+// keeps the directories the children read, in the format of the --cache
+// files, and passes them on to later children; inotify watches on the
+// directories drop them as soon as anything in them changes.
+namespace server
+{
+
+#ifdef __linux__
+
+// Serves requests on the socket at `path` until killed, running each of
+// them with `run`.  Only returns on errors.
+def serve (const char *path, int (*run) (int, const char **)) -> int;
+
+// Whether this process is running a request of the server
+def in_request () -> bool;
+
+// The kept contents of the directory `id`, empty if there is none
+def find (const cache::Identity &id) -> std::string_view;
+
+// Starts watching the directory at `path`, before reading it.  Returns the
+// watch to pass to `report`, or -1.
+def watch (const fs::path &path) -> int;
+
+// Hands the contents of a directory read after `watch` to the server.  Every
+// watch has to be reported, with empty `data` if there is nothing to keep,
+// so the server can remove it.
+def report (int wd, std::string_view data) -> void;
+
+#else
+
+inline def in_request () -> bool { return false; }
+
+#endif
+
+}
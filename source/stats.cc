@@ -0,0 +1,142 @@
+#include "stats.hh"
+
+#ifdef LST_STATS
+
+namespace stats
+{
+
+std::atomic<std::uint64_t> G_counters[counter_count];
+
+static std::atomic<std::uint64_t> S_wall[phase_count];
+static std::atomic<std::uint64_t> S_cpu[phase_count];
+
+static let S_start = std::chrono::steady_clock::now ();
+
+static constexpr const char *S_phase_names[phase_count] = {
+  "enumerate", "metadata", "owners", "sort", "layout", "render", "output"
+};
+
+static constexpr const char *S_counter_names[counter_count] = {
+  "entries", "directories", "cached_directories", "stat_calls",
+  "readlink_calls", "nss_lookups", "owner_cache_hits", "bytes_written"
+};
+
+struct Sample
+{
+  // Nanoseconds
+  std::uint64_t wall;
+  std::uint64_t cpu;
+};
+
+static def now () -> Sample
+{
+  let const wall = std::chrono::duration_cast<std::chrono::nanoseconds> (
+    std::chrono::steady_clock::now () - S_start).count ();
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetThreadTimes (GetCurrentThread (), &creation, &exit, &kernel, &user);
+  let const to_ns = [](FILETIME ft) {
+    return ((std::uint64_t (ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100;
+  };
+  let const cpu = to_ns (kernel) + to_ns (user);
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts);
+  let const cpu = std::uint64_t (ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#endif
+  return {static_cast<std::uint64_t> (wall), cpu};
+}
+
+// CPU time of all threads, in nanoseconds
+static def process_cpu () -> std::uint64_t
+{
+#ifdef _WIN32
+  FILETIME creation, exit, kernel, user;
+  GetProcessTimes (GetCurrentProcess (), &creation, &exit, &kernel, &user);
+  let const to_ns = [](FILETIME ft) {
+    return ((std::uint64_t (ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100;
+  };
+  return to_ns (kernel) + to_ns (user);
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return std::uint64_t (ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+#endif
+}
+
+// The phase the calling thread is in, and when it entered it
+static thread_local int S_phase = -1;
+static thread_local Sample S_since;
+
+static def charge (const Sample &t) -> void
+{
+  if (S_phase >= 0)
+    {
+      S_wall[S_phase].fetch_add (t.wall - S_since.wall, std::memory_order_relaxed);
+      S_cpu[S_phase].fetch_add (t.cpu - S_since.cpu, std::memory_order_relaxed);
+    }
+  S_since = t;
+}
+
+Timer::Timer (Phase phase)
+  : M_previous (S_phase)
+{
+  charge (now ());
+  S_phase = phase;
+}
+
+Timer::~Timer ()
+{
+  charge (now ());
+  S_phase = M_previous;
+}
+
+def restart () -> void
+{
+  S_start = std::chrono::steady_clock::now ();
+  for (let &c : G_counters)
+    c = 0;
+  for (std::size_t i = 0; i < phase_count; ++i)
+    {
+      S_wall[i] = 0;
+      S_cpu[i] = 0;
+    }
+}
+
+def print (bool json) -> void
+{
+  let const wall = now ().wall;
+  let const cpu = process_cpu ();
+  let const ms = [](std::uint64_t ns) { return double (ns) / 1e6; };
+
+  if (json)
+    {
+      std::fputs ("{\"phases\":{", stderr);
+      for (let i = 0; i < phase_count; ++i)
+        std::fprintf (stderr, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}",
+                      i ? "," : "", S_phase_names[i],
+                      ms (S_wall[i].load ()), ms (S_cpu[i].load ()));
+      std::fputs ("},\"counters\":{", stderr);
+      for (let i = 0; i < counter_count; ++i)
+        std::fprintf (stderr, "%s\"%s\":%llu", i ? "," : "", S_counter_names[i],
+                      static_cast<unsigned long long> (G_counters[i].load ()));
+      std::fprintf (stderr, "},\"wall_ms\":%.3f,\"cpu_ms\":%.3f}\n",
+                    ms (wall), ms (cpu));
+      return;
+    }
+
+  // Phases that ran on several threads add up the time of all of them
+  std::fprintf (stderr, "%-18s %12s %12s\n", "phase", "wall ms", "cpu ms");
+  for (let i = 0; i < phase_count; ++i)
+    std::fprintf (stderr, "%-18s %12.3f %12.3f\n", S_phase_names[i],
+                  ms (S_wall[i].load ()), ms (S_cpu[i].load ()));
+  std::fprintf (stderr, "%-18s %12.3f %12.3f\n", "total", ms (wall), ms (cpu));
+  std::fputc ('\n', stderr);
+  for (let i = 0; i < counter_count; ++i)
+    std::fprintf (stderr, "%-18s %12llu\n", S_counter_names[i],
+                  static_cast<unsigned long long> (G_counters[i].load ()));
+}
+
+}
+
+#endif
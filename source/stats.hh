@@ -0,0 +1,92 @@
+#pragma once
+#include "stdafx.hh"
+
+// Phase timings and counters for --stats.  They are only collected if lst is
+// built with LST_STATS (make STATS=1); otherwise everything here is empty and
+// the calls compile to nothing.
+namespace stats
+{
+
+enum Phase
+{
+  // Reading directories, including the stat calls for their entries
+  enumerate,
+  // Building the FileInfos
+  metadata,
+  // Bulk user and group name lookups
+  owners,
+  sort,
+  layout,
+  // Formatting into the output buffer
+  render,
+  // Writing the output buffer
+  output,
+  phase_count
+};
+
+enum Counter
+{
+  entries,
+  directories,
+  // Directories served from --cache
+  cached_directories,
+  stat_calls,
+  readlink_calls,
+  nss_lookups,
+  owner_cache_hits,
+  bytes_written,
+  counter_count
+};
+
+#ifdef LST_STATS
+
+constexpr bool enabled = true;
+
+extern std::atomic<std::uint64_t> G_counters[counter_count];
+
+inline def add (Counter c, std::uint64_t n = 1) -> void
+{
+  G_counters[c].fetch_add (n, std::memory_order_relaxed);
+}
+
+// Charges the time until its destruction to `phase`.  Timers nest: while an
+// inner one is alive the outer phase is paused, so every moment is counted
+// for exactly one phase.
+class Timer
+{
+public:
+  Timer (Phase phase);
+
+  Timer (const Timer &) = delete;
+
+  ~Timer ();
+
+private:
+  int M_previous;
+};
+
+// Forgets everything measured so far, for the children of the server
+def restart () -> void;
+
+// Prints the report to stderr
+def print (bool json) -> void;
+
+#else
+
+constexpr bool enabled = false;
+
+inline def add (Counter, std::uint64_t = 1) -> void {}
+
+class Timer
+{
+public:
+  Timer (Phase) {}
+};
+
+inline def restart () -> void {}
+
+inline def print (bool) -> void {}
+
+#endif
+
+}
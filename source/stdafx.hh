@@ -9,19 +9,36 @@
 #include <ctime>
 #include <cstring>
 #include <cmath>
+#include <climits>
+#include <cstdarg>
 
 #include <vector>
 #include <string>
 #include <string_view>
 #include <list>
+#include <deque>
 #include <bitset>
 #include <map>
+#include <unordered_map>
 #include <optional>
+#include <span>
+#include <memory>
 
 #include <algorithm>
+#include <numeric>
 #include <filesystem>
 #include <functional>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <bit>
+#include <compare>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
 
 #ifdef _WIN32
 #define WIN32_MEAN_AND_LEAN
@@ -46,10 +63,30 @@
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <pwd.h>
 #include <grp.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <signal.h>
 #include <errno.h>
+#include <sys/sysmacros.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/inotify.h>
+#endif
+
+#if defined(__linux__) && defined(STATX_TYPE)
+#define HAVE_STATX 1
+#endif
+#if defined(HAVE_STATX) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
 #endif // _WIN32
 
 #include "arena_alloc/arena_alloc.hh"
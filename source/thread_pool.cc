@@ -0,0 +1,107 @@
+#include "thread_pool.hh"
+
+// Index of the calling thread's queue if it is a worker of S_pool
+static thread_local const ThreadPool *S_pool = nullptr;
+static thread_local unsigned S_worker_id = 0;
+
+ThreadPool::ThreadPool (unsigned threads)
+  : M_queues {}
+  , M_threads {}
+  , M_queued (0)
+  , M_next_queue (0)
+  , M_stop (false)
+{
+  if (threads == 0)
+    threads = 1;
+  M_queues.reserve (threads);
+  for (unsigned i = 0; i < threads; ++i)
+    M_queues.push_back (std::make_unique<Queue> ());
+  M_threads.reserve (threads);
+  for (unsigned i = 0; i < threads; ++i)
+    M_threads.emplace_back (&ThreadPool::worker, this, i);
+}
+
+ThreadPool::~ThreadPool ()
+{
+  {
+    std::lock_guard lock (M_mutex);
+    M_stop = true;
+  }
+  M_wake.notify_all ();
+  for (let &t : M_threads)
+    t.join ();
+}
+
+def ThreadPool::submit (Task task) -> void
+{
+  unsigned id;
+  if (S_pool == this)
+    id = S_worker_id;
+  else
+    {
+      std::lock_guard lock (M_mutex);
+      id = M_next_queue;
+      M_next_queue = (M_next_queue + 1) % M_queues.size ();
+    }
+
+  {
+    let &q = *M_queues[id];
+    std::lock_guard lock (q.mutex);
+    q.tasks.push_back (std::move (task));
+  }
+
+  {
+    std::lock_guard lock (M_mutex);
+    ++M_queued;
+  }
+  M_wake.notify_one ();
+}
+
+def ThreadPool::pop (unsigned id, Task &out) -> bool
+{
+  let const n = M_queues.size ();
+  // Own queue first (LIFO keeps the working set small), then steal the oldest
+  // task from the others.
+  for (std::size_t i = 0; i < n; ++i)
+    {
+      let &q = *M_queues[(id + i) % n];
+      std::unique_lock lock (q.mutex);
+      if (q.tasks.empty ())
+        continue;
+      if (i == 0)
+        {
+          out = std::move (q.tasks.back ());
+          q.tasks.pop_back ();
+        }
+      else
+        {
+          out = std::move (q.tasks.front ());
+          q.tasks.pop_front ();
+        }
+      lock.unlock ();
+      std::lock_guard count_lock (M_mutex);
+      --M_queued;
+      return true;
+    }
+  return false;
+}
+
+def ThreadPool::worker (unsigned id) -> void
+{
+  S_pool = this;
+  S_worker_id = id;
+  Task task;
+  for (;;)
+    {
+      if (pop (id, task))
+        {
+          task ();
+          task = nullptr;
+          continue;
+        }
+      std::unique_lock lock (M_mutex);
+      M_wake.wait (lock, [this]() { return M_stop || M_queued > 0; });
+      if (M_stop)
+        return;
+    }
+}
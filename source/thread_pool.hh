@@ -0,0 +1,47 @@
+#pragma once
+#include "stdafx.hh"
+
+// A small work-stealing thread pool.  Every worker owns a deque of tasks; it
+// pushes and pops at the back of its own deque and, when that runs dry,
+// steals from the front of the other workers' deques.  Tasks submitted from a
+// worker go to that worker's deque so related work (e.g. the subdirectories of
+// a directory) stays on the same thread unless someone else is idle.
+class ThreadPool
+{
+public:
+  using Task = std::function<void ()>;
+
+  ThreadPool (unsigned threads);
+
+  // Waits for the running tasks to finish and joins all workers.  Queued tasks
+  // that have not been started yet are discarded.
+  ~ThreadPool ();
+
+  def submit (Task task) -> void;
+
+  def thread_count () const -> unsigned
+  { return static_cast<unsigned> (M_threads.size ()); }
+
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  def worker (unsigned id) -> void;
+
+  def pop (unsigned id, Task &out) -> bool;
+
+private:
+  arena::vector<std::unique_ptr<Queue>> M_queues;
+  arena::vector<std::thread> M_threads;
+  std::mutex M_mutex;
+  std::condition_variable M_wake;
+  // Number of tasks that are queued but have not been taken by a worker; may
+  // briefly be negative while a submit races with a pop.
+  std::ptrdiff_t M_queued;
+  // Queue for tasks submitted from outside the pool
+  unsigned M_next_queue;
+  bool M_stop;
+};
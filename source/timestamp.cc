@@ -0,0 +1,219 @@
+#include "timestamp.hh"
+
+namespace timestamp
+{
+
+static constexpr std::int64_t S_day = 86400;
+
+static constexpr const char *S_months[] = {
+  "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+};
+
+// Floor division, time_t may be negative
+static def floor_div (std::int64_t a, std::int64_t b) -> std::int64_t
+{
+  return a / b - (a % b < 0);
+}
+
+// The local time zone during one UTC day
+struct Zone
+{
+  std::int64_t day;
+  // False if the offset changes during the day, then localtime_r is used
+  bool uniform;
+  long offset;
+  int isdst;
+#ifndef _WIN32
+  const char *name;
+#endif
+};
+
+// Date of a local day
+struct Date
+{
+  std::int64_t day;
+  int year;
+  int month;
+  int mday;
+  int wday;
+  int yday;
+  // "%d. %b " of this day
+  char prefix[8];
+};
+
+static constexpr std::size_t S_cache_size = 64;
+static Zone S_zones[S_cache_size];
+static Date S_dates[S_cache_size];
+static bool S_initialized = false;
+
+static def system_local_time (std::time_t t, std::tm &out) -> void
+{
+#ifdef _WIN32
+  localtime_s (&out, &t);
+#else
+  localtime_r (&t, &out);
+#endif
+}
+
+// Day number relative to 1970-01-01 of a civil date, from Howard Hinnant's
+// date algorithms.
+static def days_from_civil (std::int64_t year, int month, int mday) -> std::int64_t
+{
+  year -= month <= 2;
+  let const era = floor_div (year, 400);
+  let const yoe = year - era * 400;
+  let const doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + mday - 1;
+  let const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Offset of local time from UTC, given the local time `tm` of `t`
+static def utc_offset (std::time_t t, const std::tm &tm) -> long
+{
+  let const local = (days_from_civil (tm.tm_year + 1900ll, tm.tm_mon + 1, tm.tm_mday) * S_day
+                     + tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec);
+  return static_cast<long> (local - t);
+}
+
+static def zone_of (std::time_t t) -> const Zone &
+{
+  if (!S_initialized)
+    {
+      for (let &z : S_zones)
+        z.day = INT64_MIN;
+      for (let &d : S_dates)
+        d.day = INT64_MIN;
+      S_initialized = true;
+    }
+
+  let const day = floor_div (t, S_day);
+  let &zone = S_zones[static_cast<std::uint64_t> (day) % S_cache_size];
+  if (zone.day == day)
+    return zone;
+
+  // Two transitions within one day do not happen, so if the first and last
+  // second of the day agree nothing changes in between.
+  std::tm first, last;
+  let const begin = static_cast<std::time_t> (day * S_day);
+  let const end = static_cast<std::time_t> (begin + S_day - 1);
+  system_local_time (begin, first);
+  system_local_time (end, last);
+  zone.day = day;
+  zone.offset = utc_offset (begin, first);
+  zone.isdst = first.tm_isdst;
+  zone.uniform = (zone.offset == utc_offset (end, last)
+                  && first.tm_isdst == last.tm_isdst);
+#ifndef _WIN32
+  zone.name = first.tm_zone;
+#endif
+  return zone;
+}
+
+// Civil date of a day number relative to 1970-01-01, the inverse of
+// days_from_civil.
+static def date_of (std::int64_t local_day) -> const Date &
+{
+  let &date = S_dates[static_cast<std::uint64_t> (local_day) % S_cache_size];
+  if (date.day == local_day)
+    return date;
+
+  let const z = local_day + 719468;
+  let const era = floor_div (z, 146097);
+  let const doe = z - era * 146097;
+  let const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  let const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  let const mp = (5 * doy + 2) / 153;
+  let const mday = static_cast<int> (doy - (153 * mp + 2) / 5 + 1);
+  let const month = static_cast<int> (mp < 10 ? mp + 3 : mp - 9);
+  let const year = yoe + era * 400 + (month <= 2);
+
+  let const leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+  static constexpr int days_before[] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+  date.day = local_day;
+  date.year = static_cast<int> (year);
+  date.month = month - 1;
+  date.mday = mday;
+  date.wday = static_cast<int> ((local_day % 7 + 11) % 7);
+  date.yday = days_before[month - 1] + mday - 1 + (leap && month > 2);
+  date.prefix[0] = static_cast<char> ('0' + mday / 10);
+  date.prefix[1] = static_cast<char> ('0' + mday % 10);
+  date.prefix[2] = '.';
+  date.prefix[3] = ' ';
+  std::memcpy (date.prefix + 4, S_months[month - 1], 3);
+  date.prefix[7] = ' ';
+  return date;
+}
+
+def local_time (std::time_t t, std::tm &out) -> void
+{
+  let const &zone = zone_of (t);
+  if (!zone.uniform)
+    {
+      system_local_time (t, out);
+      return;
+    }
+
+  let const local = static_cast<std::int64_t> (t) + zone.offset;
+  let const local_day = floor_div (local, S_day);
+  let const seconds = static_cast<int> (local - local_day * S_day);
+  let const &date = date_of (local_day);
+
+  out = {};
+  out.tm_sec = seconds % 60;
+  out.tm_min = seconds / 60 % 60;
+  out.tm_hour = seconds / 3600;
+  out.tm_mday = date.mday;
+  out.tm_mon = date.month;
+  out.tm_year = date.year - 1900;
+  out.tm_wday = date.wday;
+  out.tm_yday = date.yday;
+  out.tm_isdst = zone.isdst;
+#ifndef _WIN32
+  out.tm_gmtoff = zone.offset;
+  out.tm_zone = zone.name;
+#endif
+}
+
+def format_default (std::time_t t, std::time_t six_months_ago, char *out) -> std::size_t
+{
+  let const old = std::difftime (t, six_months_ago) < 0;
+  let const &zone = zone_of (t);
+  if (!zone.uniform)
+    {
+      std::tm tm;
+      system_local_time (t, tm);
+      return std::strftime (out, 32, old ? "%d. %b  %Y" : "%d. %b %H:%M", &tm);
+    }
+
+  let const local = static_cast<std::int64_t> (t) + zone.offset;
+  let const local_day = floor_div (local, S_day);
+  let const &date = date_of (local_day);
+
+  std::memcpy (out, date.prefix, 8);
+  if (old)
+    {
+      if (date.year < 1000 || date.year > 9999)
+        return 8 + std::snprintf (out + 8, 24, " %d", date.year);
+      out[8] = ' ';
+      out[9] = static_cast<char> ('0' + date.year / 1000);
+      out[10] = static_cast<char> ('0' + date.year / 100 % 10);
+      out[11] = static_cast<char> ('0' + date.year / 10 % 10);
+      out[12] = static_cast<char> ('0' + date.year % 10);
+    }
+  else
+    {
+      let const seconds = static_cast<int> (local - local_day * S_day);
+      let const hour = seconds / 3600;
+      let const minute = seconds / 60 % 60;
+      out[8] = static_cast<char> ('0' + hour / 10);
+      out[9] = static_cast<char> ('0' + hour % 10);
+      out[10] = ':';
+      out[11] = static_cast<char> ('0' + minute / 10);
+      out[12] = static_cast<char> ('0' + minute % 10);
+    }
+  return default_width;
+}
+
+}
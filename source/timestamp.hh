@@ -0,0 +1,22 @@
+#pragma once
+#include "stdafx.hh"
+
+// Conversion of file times to local time and their formatting for long
+// listings.  The UTC offset is looked up once per day of the listed times
+// instead of going through localtime for every file, and the default
+// layouts are rendered with integer arithmetic.
+namespace timestamp
+{
+
+// Length of the default layouts for 4 digit years
+inline constexpr int default_width = 13;
+
+// Like localtime_r
+def local_time (std::time_t t, std::tm &out) -> void;
+
+// Writes `t` as "%d. %b %H:%M", or as "%d. %b  %Y" if it is older than
+// `six_months_ago`, to `out` which must hold at least 32 characters.
+// Returns the number of characters written.
+def format_default (std::time_t t, std::time_t six_months_ago, char *out) -> std::size_t;
+
+}
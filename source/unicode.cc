@@ -1,4 +1,5 @@
 #include "unicode.hh"
+#include "width_table.hh"
 
 namespace unicode
 {
@@ -15,13 +16,14 @@ def CodepointIterator::end () const -> CodepointIterator
 
 def CodepointIterator::operator * () -> char32_t
 {
-  return utf8_to_codepoint (M_pointer, &M_cp_size);
+  return utf8_to_codepoint (M_pointer, M_end, &M_cp_size);
 }
 
 def CodepointIterator::operator ++ () -> CodepointIterator &
 {
-  M_pointer += (1 + (M_pointer[0] >= 0x80) + (M_pointer[0] >= 0xe0)
-                + (M_pointer[0] >= 0xf0));
+  int size;
+  utf8_to_codepoint (M_pointer, M_end, &size);
+  M_pointer += size;
   return *this;
 }
 
@@ -37,74 +39,134 @@ def CodepointIterator::operator != (const CodepointIterator &other) -> bool
   return M_pointer != other.M_pointer;
 }
 
-def utf8_to_codepoint (const char8_t *bytes, int *cp_size) -> char32_t
+def utf8_to_codepoint (const char8_t *bytes, const char8_t *end,
+                       int *cp_size) -> char32_t
 {
-  if (bytes[0] < 0x80)
+  let const is_continuation = [](char8_t b) { return (b & 0xc0) == 0x80; };
+  let const b0 = bytes[0];
+  let const avail = end - bytes;
+  let size = 1;
+  let c = char32_t (0xfffd);
+
+  if (b0 < 0x80)
+    c = b0;
+  else if (b0 >= 0xc2 && b0 < 0xe0)
+    {
+      if (avail >= 2 && is_continuation (bytes[1]))
+        {
+          size = 2;
+          c = (char32_t (b0 & 0x1f) << 6) | (bytes[1] & 0x3f);
+        }
+    }
+  else if (b0 >= 0xe0 && b0 < 0xf0)
     {
-      if (cp_size) *cp_size = 1;
-      return bytes[0];
+      // Excludes overlong encodings and surrogates
+      if (avail >= 3 && is_continuation (bytes[1]) && is_continuation (bytes[2])
+          && !(b0 == 0xe0 && bytes[1] < 0xa0)
+          && !(b0 == 0xed && bytes[1] >= 0xa0))
+        {
+          size = 3;
+          c = ((char32_t (b0 & 0xf) << 12)
+               | (char32_t (bytes[1] & 0x3f) << 6)
+               | (bytes[2] & 0x3f));
+        }
     }
-  else if (bytes[0] < 0xe0)
+  else if (b0 >= 0xf0 && b0 < 0xf5)
     {
-      if (cp_size) *cp_size = 2;
-      return (char32_t (bytes[0] & 0x1f) << 6) | (bytes[1] & 0x3f);
+      // Excludes overlong encodings and codepoints above U+10FFFF
+      if (avail >= 4 && is_continuation (bytes[1]) && is_continuation (bytes[2])
+          && is_continuation (bytes[3])
+          && !(b0 == 0xf0 && bytes[1] < 0x90)
+          && !(b0 == 0xf4 && bytes[1] >= 0x90))
+        {
+          size = 4;
+          c = ((char32_t (b0 & 0x7) << 18)
+               | (char32_t (bytes[1] & 0x3f) << 12)
+               | (char32_t (bytes[2] & 0x3f) << 6)
+               | (bytes[3] & 0x3f));
+        }
     }
-  else if (bytes[0] < 0xf0)
+
+  if (cp_size) *cp_size = size;
+  return c;
+}
+
+def ascii_prefix (const char8_t *begin, const char8_t *end) -> std::size_t
+{
+  let p = begin;
+#ifdef __AVX2__
+  for (; end - p >= 32; p += 32)
     {
-      if (cp_size) *cp_size = 3;
-      return ((char32_t (bytes[0] & 0xf) << 12)
-              | (char32_t (bytes[1] & 0x3f) << 6)
-              | (bytes[2] & 0x3f));
+      let const v = _mm256_loadu_si256 (reinterpret_cast<const __m256i *> (p));
+      if (let const mask = static_cast<unsigned> (_mm256_movemask_epi8 (v)); mask)
+        return (p - begin) + std::countr_zero (mask);
     }
-  else
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+  for (; end - p >= 16; p += 16)
     {
-      if (cp_size) *cp_size = 4;
-      return ((char32_t (bytes[0] & 0x7) << 18)
-              | (char32_t (bytes[1] & 0x3f) << 12)
-              | (char32_t (bytes[2] & 0x3f) << 6)
-              | (bytes[3] & 0x3f));
+      let const v = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p));
+      if (let const mask = static_cast<unsigned> (_mm_movemask_epi8 (v)); mask)
+        return (p - begin) + std::countr_zero (mask);
     }
+#endif
+  for (; end - p >= 8; p += 8)
+    {
+      std::uint64_t word;
+      std::memcpy (&word, p, 8);
+      if (word & 0x8080808080808080)
+        break;
+    }
+  while (p != end && *p < 0x80)
+    ++p;
+  return p - begin;
 }
 
 def display_width (char32_t ch) -> int
 {
-  // Note: For performance this does not check for zero-width characters.
-  if (ch == 0)
-    return 0;
-  return (1
-          + (ch >= 0x1100
-             && (ch <= 0x115f || ch == 0x2329 || ch == 0x232a
-                 || (ch >= 0x2e80 && ch <= 0xa4cf && ch != 0x303f)
-                 || (ch >= 0xac00 && ch <= 0xd7a3)
-                 || (ch >= 0xf900 && ch <= 0xfaff)
-                 || (ch >= 0xfe10 && ch <= 0xfe19)
-                 || (ch >= 0xfe30 && ch <= 0xfe6f)
-                 || (ch >= 0xff00 && ch <= 0xff60)
-                 || (ch >= 0xffe0 && ch <= 0xffe6)
-                 || (ch >= 0x20000 && ch <= 0x2fffd)
-                 || (ch >= 0x30000 && ch <= 0x3fffd))));
+  using namespace width_table;
+  if (ch > 0x10ffff)
+    return 1;
+  let const block = stage1[ch / block_size];
+  let const packed = stage2[block][ch % block_size / 4];
+  return (packed >> (ch % 4 * 2)) & 3;
 }
 
-def display_width (const arena::string &str) -> int
+def display_width (std::string_view str) -> int
 {
+  let p = reinterpret_cast<const char8_t *> (str.data ());
+  let const end = p + str.size ();
   let w = 0;
-  let const iter = CodepointIterator (str);
-  for (let c : iter)
-    w += display_width (c);
+  while (p != end)
+    {
+      let const ascii = ascii_prefix (p, end);
+      w += static_cast<int> (ascii);
+      p += ascii;
+      if (p == end)
+        break;
+      int size;
+      w += display_width (utf8_to_codepoint (p, end, &size));
+      p += size;
+    }
   return w;
 }
 
-def padding_offset (const arena::string &str) -> int
+def padding_offset (std::string_view str) -> int
 {
-  let iter = CodepointIterator (str);
+  // ASCII characters take as many columns as bytes so only the others add
+  // to the offset.
+  let p = reinterpret_cast<const char8_t *> (str.data ());
+  let const end = p + str.size ();
   let o = 0;
-  // For some reason CodepointIterator::M_cp_size does not get set when using
-  // the range based for loop
-  for (; iter != iter.end (); ++iter)
+  while (p != end)
     {
-      let const c = *iter;
-      if (c)
-        o += iter.cp_size () - display_width (c);
+      p += ascii_prefix (p, end);
+      if (p == end)
+        break;
+      int size;
+      let const c = utf8_to_codepoint (p, end, &size);
+      o += size - display_width (c);
+      p += size;
     }
   return o;
 }
@@ -121,4 +183,14 @@ def path_to_str (const fs::path &p) -> arena::string
 #endif
 }
 
+def str_to_path (std::string_view str) -> fs::path
+{
+#ifdef _WIN32
+  return fs::path (std::u8string_view (reinterpret_cast<const char8_t *> (str.data ()),
+                                       str.size ()));
+#else
+  return fs::path (str);
+#endif
+}
+
 }
@@ -48,18 +48,30 @@ private:
   int M_cp_size;
 };
 
-def utf8_to_codepoint (const char8_t *bytes, int *cp_size = nullptr) -> char32_t;
+// Decodes the codepoint at `bytes`, reading no further than `end`.  Invalid
+// or truncated sequences decode to U+FFFD with a size of one byte.
+def utf8_to_codepoint (const char8_t *bytes, const char8_t *end,
+                       int *cp_size = nullptr) -> char32_t;
 
-static inline def utf8_to_codepoint (const char *bytes, int *cp_size = nullptr) -> char32_t
-{ return utf8_to_codepoint (reinterpret_cast<const char8_t *> (bytes), cp_size); }
+static inline def utf8_to_codepoint (const char *bytes, const char *end,
+                                     int *cp_size = nullptr) -> char32_t
+{
+  return utf8_to_codepoint (reinterpret_cast<const char8_t *> (bytes),
+                            reinterpret_cast<const char8_t *> (end), cp_size);
+}
+
+// Number of leading ASCII bytes in [begin, end)
+def ascii_prefix (const char8_t *begin, const char8_t *end) -> std::size_t;
 
 def display_width (char32_t ch) -> int;
 
-def display_width (const arena::string &str) -> int;
+def display_width (std::string_view str) -> int;
 
 // Used to adjust the padding amount in printf.
-def padding_offset (const arena::string &str) -> int;
+def padding_offset (std::string_view str) -> int;
 
 def path_to_str (const fs::path &p) -> arena::string;
 
+def str_to_path (std::string_view str) -> fs::path;
+
 }
@@ -0,0 +1,214 @@
+#include "uring.hh"
+
+#ifdef HAVE_IO_URING
+
+namespace uring
+{
+
+// Set once setting up a ring or running statx through it failed in a way that
+// will not get better, so other threads do not try again.
+static std::atomic<bool> S_unavailable = false;
+
+static constexpr unsigned S_ring_entries = 256;
+
+class Ring
+{
+public:
+  Ring ()
+  {
+    io_uring_params params {};
+    M_fd = static_cast<int> (syscall (__NR_io_uring_setup, S_ring_entries, &params));
+    if (M_fd == -1)
+      return;
+
+    M_sq_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    M_cq_size = params.cq_off.cqes + params.cq_entries * sizeof (io_uring_cqe);
+    let const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap)
+      M_sq_size = M_cq_size = std::max (M_sq_size, M_cq_size);
+
+    M_sq = map (M_sq_size, IORING_OFF_SQ_RING);
+    M_cq = single_mmap ? M_sq : map (M_cq_size, IORING_OFF_CQ_RING);
+    M_sqes_size = params.sq_entries * sizeof (io_uring_sqe);
+    M_sqes = static_cast<io_uring_sqe *> (map (M_sqes_size, IORING_OFF_SQES));
+    if (!M_sq || !M_cq || !M_sqes)
+      {
+        unmap ();
+        close (M_fd);
+        M_fd = -1;
+        return;
+      }
+
+    let const sq = static_cast<char *> (M_sq);
+    M_sq_head = reinterpret_cast<unsigned *> (sq + params.sq_off.head);
+    M_sq_tail = reinterpret_cast<unsigned *> (sq + params.sq_off.tail);
+    M_sq_mask = *reinterpret_cast<unsigned *> (sq + params.sq_off.ring_mask);
+    M_sq_array = reinterpret_cast<unsigned *> (sq + params.sq_off.array);
+    M_sq_entries = params.sq_entries;
+
+    let const cq = static_cast<char *> (M_cq);
+    M_cq_head = reinterpret_cast<unsigned *> (cq + params.cq_off.head);
+    M_cq_tail = reinterpret_cast<unsigned *> (cq + params.cq_off.tail);
+    M_cq_mask = *reinterpret_cast<unsigned *> (cq + params.cq_off.ring_mask);
+    M_cqes = reinterpret_cast<io_uring_cqe *> (cq + params.cq_off.cqes);
+  }
+
+  Ring (const Ring &) = delete;
+
+  ~Ring ()
+  {
+    if (M_fd != -1)
+      {
+        unmap ();
+        close (M_fd);
+      }
+  }
+
+  def ok () const -> bool { return M_fd != -1; }
+
+  def run (std::span<StatxRequest> requests) -> void;
+
+private:
+  def map (std::size_t size, off_t offset) -> void *
+  {
+    let const p = mmap (nullptr, size, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, M_fd, offset);
+    return p == MAP_FAILED ? nullptr : p;
+  }
+
+  def unmap () -> void
+  {
+    if (M_sqes)
+      munmap (M_sqes, M_sqes_size);
+    if (M_cq && M_cq != M_sq)
+      munmap (M_cq, M_cq_size);
+    if (M_sq)
+      munmap (M_sq, M_sq_size);
+  }
+
+  static def load (unsigned *p) -> unsigned
+  {
+    return std::atomic_ref<unsigned> (*p).load (std::memory_order_acquire);
+  }
+
+  static def store (unsigned *p, unsigned value) -> void
+  {
+    std::atomic_ref<unsigned> (*p).store (value, std::memory_order_release);
+  }
+
+private:
+  int M_fd;
+  void *M_sq {nullptr};
+  void *M_cq {nullptr};
+  io_uring_sqe *M_sqes {nullptr};
+  std::size_t M_sq_size {0};
+  std::size_t M_cq_size {0};
+  std::size_t M_sqes_size {0};
+  unsigned *M_sq_head {nullptr};
+  unsigned *M_sq_tail {nullptr};
+  unsigned *M_sq_array {nullptr};
+  unsigned M_sq_mask {0};
+  unsigned M_sq_entries {0};
+  unsigned *M_cq_head {nullptr};
+  unsigned *M_cq_tail {nullptr};
+  unsigned M_cq_mask {0};
+  io_uring_cqe *M_cqes {nullptr};
+};
+
+def Ring::run (std::span<StatxRequest> requests) -> void
+{
+  let const n = requests.size ();
+  std::size_t next = 0;
+  std::size_t in_flight = 0;
+  // After an error nothing new is submitted, but requests the kernel already
+  // has are waited for since they write into `requests`.
+  let failed = false;
+
+  while ((!failed && next < n) || in_flight)
+    {
+      // Queue as many requests as fit; the completion ring is twice the size
+      // of the submission ring so limiting the requests in flight to the
+      // latter means completions can never overflow.
+      let tail = *M_sq_tail;
+      let const head = load (M_sq_head);
+      while (!failed && next < n && in_flight < M_sq_entries
+             && tail - head < M_sq_entries)
+        {
+          let const &r = requests[next];
+          let const index = tail & M_sq_mask;
+          let &sqe = M_sqes[index];
+          sqe = {};
+          sqe.opcode = IORING_OP_STATX;
+          sqe.fd = r.dir_fd;
+          sqe.addr = reinterpret_cast<std::uintptr_t> (r.name);
+          sqe.len = r.mask;
+          sqe.off = reinterpret_cast<std::uintptr_t> (r.out);
+          sqe.statx_flags = static_cast<__u32> (r.flags);
+          sqe.user_data = next;
+          M_sq_array[index] = index;
+          ++tail;
+          ++next;
+          ++in_flight;
+        }
+      store (M_sq_tail, tail);
+      // Everything the kernel has not consumed yet, including entries left
+      // over by an earlier call that was interrupted or submitted only some
+      // of them; waiting without submitting those would never return.
+      let const to_submit = tail - head;
+
+      let const ret = syscall (__NR_io_uring_enter, M_fd, to_submit, 1,
+                               IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (ret == -1 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+          // Nothing was consumed, take the unsubmitted requests back
+          store (M_sq_tail, tail - to_submit);
+          next -= to_submit;
+          in_flight -= to_submit;
+          // The requests in flight still complete; any system call runs the
+          // pending task work that posts them.
+          if (failed)
+            std::this_thread::yield ();
+          failed = true;
+          S_unavailable = true;
+        }
+
+      let cq_head = *M_cq_head;
+      let const cq_tail = load (M_cq_tail);
+      for (; cq_head != cq_tail; ++cq_head)
+        {
+          let const &cqe = M_cqes[cq_head & M_cq_mask];
+          let &r = requests[cqe.user_data];
+          if (cqe.res == -EINVAL)
+            {
+              // Kernel without IORING_OP_STATX; the flags and mask we pass
+              // are always valid for statx itself.
+              failed = true;
+              S_unavailable = true;
+            }
+          else
+            r.error = cqe.res < 0 ? -cqe.res : 0;
+          --in_flight;
+        }
+      store (M_cq_head, cq_head);
+    }
+}
+
+def statx_all (std::span<StatxRequest> requests) -> bool
+{
+  if (S_unavailable.load (std::memory_order_relaxed))
+    return false;
+  static thread_local Ring S_ring;
+  if (!S_ring.ok ())
+    {
+      S_unavailable = true;
+      return false;
+    }
+  for (let &r : requests)
+    r.error = not_run;
+  S_ring.run (requests);
+  return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,32 @@
+#pragma once
+#include "stdafx.hh"
+
+#ifdef HAVE_IO_URING
+
+// Batched statx calls through io_uring.  Every thread gets its own ring, set
+// up on first use; if the kernel does not support io_uring (or it is
+// disabled) the calls report that and the caller stats synchronously.
+namespace uring
+{
+
+struct StatxRequest
+{
+  int dir_fd;
+  const char *name;
+  int flags;
+  unsigned mask;
+  struct statx *out;
+  // 0 or the errno of the call; `not_run` if the request was not completed
+  int error;
+};
+
+constexpr int not_run = -1;
+
+// Runs all `requests`, keeping as many of them in flight as the ring allows.
+// Returns false if io_uring is not available, in which case none were run.
+// Requests that could not be completed are left at `not_run`.
+def statx_all (std::span<StatxRequest> requests) -> bool;
+
+}
+
+#endif
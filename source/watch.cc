@@ -0,0 +1,258 @@
+#include "watch.hh"
+#include "lst.hh"
+#include "args.hh"
+
+#ifdef __linux__
+
+namespace watch
+{
+
+// Events that change the entries of a directory
+static constexpr std::uint32_t S_watch_mask = (IN_ATTRIB | IN_CREATE | IN_DELETE
+                                               | IN_DELETE_SELF | IN_MODIFY
+                                               | IN_MOVE_SELF | IN_MOVED_FROM
+                                               | IN_MOVED_TO | IN_ONLYDIR);
+
+// Events that follow each other within this many milliseconds are applied
+// together, so a burst of changes is drawn once.
+static constexpr int S_settle_ms = 50;
+// While events keep coming the output is still redrawn this often
+static constexpr auto S_max_delay = std::chrono::milliseconds (500);
+
+// A watched directory of G_directories
+struct Watched
+{
+  const fs::path *path;
+  FileList *files;
+  // Index in files->entries () of each listed entry
+  std::unordered_map<std::string, std::uint32_t> index;
+};
+
+// The names of the entries that changed, by watch descriptor
+using Changes = std::map<int, std::vector<std::string>>;
+
+// Watched directories by watch descriptor; the same directory may be listed
+// more than once.
+using Watches = std::unordered_multimap<int, Watched>;
+
+// Kept between listings, so changes made while the listing is made again are
+// still seen.
+static int S_inotify_fd = -1;
+static std::vector<int> S_watches;
+
+
+static def index_of (FileList &files) -> std::unordered_map<std::string, std::uint32_t>
+{
+  std::unordered_map<std::string, std::uint32_t> index;
+  index.reserve (files.size ());
+  for (let const i : files.order ())
+    index.emplace (files.entries ()[i].file_name (), i);
+  return index;
+}
+
+
+// Reads all pending events into `changes`.  Returns false if the listing has
+// to be made again.
+static def read_events (const Watches &watched, Changes &changes) -> bool
+{
+  alignas (inotify_event) char buf[64 * 1024];
+  for (;;)
+    {
+      let const n = read (S_inotify_fd, buf, sizeof (buf));
+      if (n <= 0)
+        return true;
+      for (let p = buf; p < buf + n; )
+        {
+          let const &e = *reinterpret_cast<const inotify_event *> (p);
+          p += sizeof (inotify_event) + e.len;
+          // Events were lost
+          if (e.mask & IN_Q_OVERFLOW)
+            return false;
+          // Left over from directories of an earlier listing
+          if (!watched.contains (e.wd))
+            continue;
+          // A listed directory went away
+          if (e.mask & (IN_DELETE_SELF | IN_MOVE_SELF))
+            return false;
+          // With -R a directory coming or going changes which directories
+          // are listed.
+          if (Arguments::recursive && (e.mask & IN_ISDIR)
+              && (e.mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)))
+            return false;
+          if (e.len)
+            changes[e.wd].emplace_back (e.name);
+        }
+    }
+}
+
+
+// Whether -R could descend into the entry
+static def may_descend (const FileInfo &f) -> bool
+{
+  return (f.type == fs::file_type::directory
+          || f.type == fs::file_type::symlink);
+}
+
+
+// Reads the entries `names` of `w` again.  Returns false if the listing has
+// to be made again.
+static def apply (Watched &w, std::vector<std::string> &names) -> bool
+{
+  std::sort (names.begin (), names.end ());
+  names.erase (std::unique (names.begin (), names.end ()), names.end ());
+
+  let const dir_fd = open (w.path->c_str (), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd == -1)
+    return false;
+  // The old entries are taken out and the new ones merged in for the whole
+  // batch at once, so it takes two passes over the listing however many
+  // entries changed.
+  std::vector<bool> descended (names.size (), false);
+  std::vector<std::uint32_t> removed;
+  for (std::size_t n = 0; n < names.size (); ++n)
+    if (let const it = w.index.find (names[n]); it != w.index.end ())
+      {
+        descended[n] = may_descend (w.files->entries ()[it->second]);
+        removed.push_back (it->second);
+        w.index.erase (it);
+      }
+  std::sort (removed.begin (), removed.end ());
+  w.files->remove (removed);
+
+  let const added = insert_entries (*w.files, dir_fd, *w.path, names);
+  let again = false;
+  for (std::size_t n = 0; n < names.size (); ++n)
+    {
+      let descends = false;
+      if (added[n])
+        {
+          descends = may_descend (w.files->entries ()[*added[n]]);
+          w.index.emplace (names[n], *added[n]);
+        }
+      if (Arguments::recursive && descended[n] != descends)
+        again = true;
+    }
+  close (dir_fd);
+
+  // Changed entries are added anew, so drop the old ones once they make up
+  // most of the list.
+  if (w.files->entries ().size () > 2 * w.files->size () + 1024)
+    {
+      w.files->compact ();
+      w.index = index_of (*w.files);
+    }
+  return !again;
+}
+
+
+// Whether the directory at `path` changed at or after `time`
+static def changed_since (const fs::path &path, const timespec &time) -> bool
+{
+  let const not_before = [&time](const timespec &t) {
+    return (t.tv_sec != time.tv_sec
+            ? t.tv_sec > time.tv_sec
+            : t.tv_nsec >= time.tv_nsec);
+  };
+  // One that went away is noticed by its watch
+  struct stat sb;
+  return (stat (path.c_str (), &sb) == 0
+          && (not_before (sb.st_mtim) || not_before (sb.st_ctim)));
+}
+
+
+def listing_time () -> timespec
+{
+  // The clock file times are taken from, so a change after this never gets
+  // an earlier time.
+  timespec now;
+  clock_gettime (CLOCK_REALTIME_COARSE, &now);
+  return now;
+}
+
+
+def follow (const std::function<void ()> &redraw, const timespec &listed_at) -> bool
+{
+  if (S_inotify_fd == -1)
+    S_inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+  if (S_inotify_fd == -1)
+    {
+      std::fprintf (stderr, "%s: inotify: %s\n", G_program, std::strerror (errno));
+      return false;
+    }
+  let const fd = S_inotify_fd;
+
+  Watches watched;
+  // A directory that was not watched while it was read may have changed
+  // before it was watched; it is read again.
+  let changed = false;
+  for (let &[path, files] : G_directories)
+    {
+      let const wd = inotify_add_watch (fd, path.c_str (), S_watch_mask);
+      if (wd == -1)
+        {
+          std::fprintf (stderr, "%s: cannot watch '%s': %s\n", G_program,
+                        path.c_str (), std::strerror (errno));
+          continue;
+        }
+      if (!changed
+          && std::find (S_watches.begin (), S_watches.end (), wd) == S_watches.end ())
+        changed = changed_since (path, listed_at);
+      watched.emplace (wd, Watched { &path, &files, index_of (files) });
+    }
+  for (let const wd : S_watches)
+    if (!watched.contains (wd))
+      inotify_rm_watch (fd, wd);
+  S_watches.clear ();
+  for (let const &[wd, w] : watched)
+    S_watches.push_back (wd);
+
+  if (watched.empty ())
+    {
+      // Failed watches were reported above
+      if (G_directories.empty ())
+        std::fprintf (stderr, "%s: nothing to watch: files named on the command"
+                      " line are not watched\n", G_program);
+      return false;
+    }
+  if (changed)
+    return true;
+
+  pollfd pfd { fd, POLLIN, 0 };
+  for (;;)
+    {
+      if (poll (&pfd, 1, -1) == -1)
+        {
+          if (errno == EINTR)
+            continue;
+          std::fprintf (stderr, "%s: poll: %s\n", G_program, std::strerror (errno));
+          return false;
+        }
+
+      Changes changes;
+      let again = false;
+      let const start = std::chrono::steady_clock::now ();
+      do
+        again = !read_events (watched, changes);
+      while (!again
+             && std::chrono::steady_clock::now () - start < S_max_delay
+             && poll (&pfd, 1, S_settle_ms) > 0);
+
+      for (let &[wd, names] : changes)
+        {
+          if (again)
+            break;
+          let const [first, last] = watched.equal_range (wd);
+          for (let it = first; it != last && !again; ++it)
+            again = !apply (it->second, names);
+        }
+      if (again)
+        break;
+      if (!changes.empty ())
+        redraw ();
+    }
+  return true;
+}
+
+}
+
+#endif // __linux__
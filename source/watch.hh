@@ -0,0 +1,25 @@
+#pragma once
+#include "stdafx.hh"
+
+// The --watch mode.  After the first listing the directories in
+// G_directories are watched with inotify and changed entries are applied to
+// their listings in batches: only the entries named by an event are read
+// again and moved to their place in the sorted order.
+namespace watch
+{
+
+#ifdef __linux__
+
+// The time to pass to follow, taken before the directories are read
+def listing_time () -> timespec;
+
+// Waits for changes to the listed directories and applies them, calling
+// `redraw` after each batch of changes.  Returns true once the listing has to
+// be made again from scratch, like when a directory is created under -R or
+// events were lost, and false if there is nothing that can be watched.
+// `listed_at` is the listing_time of the listing.
+def follow (const std::function<void ()> &redraw, const timespec &listed_at) -> bool;
+
+#endif
+
+}